@@ -5,6 +5,10 @@ Asynchronous http/ws session
 
 \author  jiangyong
 \update
+  2026-10-16 session_http增加exportstate(),importstate(), 热重启交接websocket会话
+  2026-10-16 session_http支持直接读入_rbuf解析(EC_AIO_RECV_INPLACE)
+  2026-10-16 session_http增加sendasyn_bc(),广播时websocket帧只生成一次
+  2026-10-16 session_http增加sendasyn_ref(),websocket不压缩时帧数据引用不拷贝
   2025-1-15 fix ec::aio::basews::ParseOneFrame
   2024-5-8 添加发送websocket协议断开握手控制帧。
   2023-12-13 增加会话连接消息处理均衡
@@ -380,6 +384,8 @@ namespace ec {
 				data[1] = static_cast<uint8_t>(ncode & 0xFF);
 				return ws_send(_fd, data, 2, nullptr, WS_OP_CLOSE) > 0;
 			}
+			virtual bool recvinplace() { return true; }
+
 			virtual int onrecvbytes(const void* pdata, size_t size, ec::ilog* plog, ec::bytes* pmsgout)
 			{
 				_lastappmsg = 0;
@@ -407,6 +413,57 @@ namespace ec {
 			{
 				return ws_send(_fd, pdata, size, plog);
 			}
+
+			virtual int sendasyn_ref(ec::refbuf* pbuf, ec::ilog* plog)
+			{
+				if (PROTOCOL_WS != _nws)
+					return session::sendasyn_ref(pbuf, plog);
+				if (_wscompress && pbuf->size() >= 128) //压缩后不能引用原数据
+					return sendasyn(pbuf->data(), pbuf->size(), plog);
+				uint8_t head[16];
+				unsigned char uc;
+				size_t ss = 0, us, slen = pbuf->size();
+				do { //同ws_make_permsg, 帧头拷贝, 帧数据引用
+					uc = ss ? 0 : (0x0F & WS_OP_TXT);
+					us = EC_SIZE_WS_FRAME;
+					if (ss + EC_SIZE_WS_FRAME >= slen) {
+						uc |= 0x80;
+						us = slen - ss;
+					}
+					if (!_sndbuf.appendref(pbuf, ss, us, head, ws_make_head(head, uc, us)))
+						return -1;
+					ss += us;
+				} while (ss < slen);
+				return (int)slen;
+			}
+
+			virtual int sendasyn_bc(bcframes* pfrms, ec::ilog* plog)
+			{
+				if (PROTOCOL_WS != _nws)
+					return session::sendasyn_bc(pfrms, plog);
+				int kind = bcframes::frm_ws;
+				if (ws_x_webkit_deflate_frame == _wscompress)
+					kind = bcframes::frm_wsdeflateframe;
+				else if (_wscompress)
+					kind = bcframes::frm_wsdeflate;
+				ec::refbuf* pf = pfrms->get(kind);
+				if (!pf) {
+					bool bmake;
+					size_t size = pfrms->size();
+					ec::vstream vret;
+					vret.reserve(1024 + size - size % 512);
+					if (bcframes::frm_wsdeflateframe == kind)
+						bmake = ws_make_perfrm(pfrms->data(), size, WS_OP_TXT, &vret);
+					else
+						bmake = ws_make_permsg(pfrms->data(), size, WS_OP_TXT, &vret, size > 128 && bcframes::frm_wsdeflate == kind);
+					if (!bmake || !(pf = pfrms->set(kind, vret.data(), vret.size()))) {
+						if (plog)
+							plog->add(CLOG_DEFAULT_ERR, "fd(%d) broadcast make wsframe failed,size %zu", _fd, size);
+						return -1;
+					}
+				}
+				return _sndbuf.appendref(pf, 0, pf->size()) ? (int)pfrms->size() : -1;
+			}
 			virtual bool onSendCompleted() //return false will disconnected
 			{
 				if (_protocol != EC_AIO_PROC_HTTP || !_sizefile || _downfilename.empty())
@@ -455,6 +512,27 @@ namespace ec {
 			virtual bool hasSendJob() {
 				return _sizefile && _downfilename.size();
 			};
+
+			virtual bool exportstate(ec::string& so) // 无上下文接管, 只需协议和压缩方式
+			{
+				if (!_wsmsg.empty() || hasSendJob() || _sendcloseFrame)
+					return false;
+				int32_t v[3] = { _nws, _wscompress, _opcode };
+				so.append((const char*)v, sizeof(v));
+				return true;
+			}
+
+			virtual bool importstate(const void* pdata, size_t size)
+			{
+				int32_t v[3];
+				if (size != sizeof(v))
+					return false;
+				memcpy(v, pdata, sizeof(v));
+				_nws = v[0];
+				_wscompress = v[1];
+				_opcode = v[2];
+				return true;
+			}
 		};
 	}//namespace aio
 }//namespace ec
\ No newline at end of file
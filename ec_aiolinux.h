@@ -6,6 +6,17 @@
 \author jiangyong
 
 \update
+  2026-10-16 代号改为每个槽位各自递增, 同一槽位重用约13万次后kfd才会重复; 可持续fd文件保存已用的最大代号
+  2026-10-16 增加detach_(), 热重启交接时关闭本进程的fd而不shutdown连接
+  2026-10-16 增加settcpopt(), 用于TCP_NOTSENT_LOWAT,TCP_CORK,TCP_QUICKACK,TCP_DEFER_ACCEPT,TCP_FASTOPEN
+  2026-10-16 增加setbusypoll()
+  2026-10-16 增加attach_(), 登记io_uring等外部接受的系统fd
+  2026-10-16 fd表改为按槽位索引带代号的虚拟fd表,O(1)查找; t_fd增加puser; 可持续fd改为按批预留代号写文件
+  2026-10-16 accept_使用accept4一次设置非阻塞和CLOEXEC, 收发缓冲在监听socket上设置由连接继承
+  2026-10-16 增加MSG_ZEROCOPY支持setzerocopy(), recverrq_()
+  2026-10-16 增加UDP批量收发recvmmsg_(), sendmmsg_()
+  2026-10-16 增加sendv_(),一次发送多个数据块
+  2026-10-16 增加SO_REUSEPORT监听、fd分组(多reactor)和eventfd唤醒
   2024-12-30 优化UDP接收缓冲设置
   2024-4-3  更新close_
   2023-6-6  增加可持续fd
@@ -27,9 +38,13 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <string>
 #include "ec_string.hpp"
@@ -38,10 +53,40 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #include "ec_jsonx.h"
 #include "ec_vector.hpp"
 #include "ec_diskio.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef TCP_FASTOPEN
+#define TCP_FASTOPEN 23
+#endif
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
 #ifndef SIZE_MAX_FD
 #define SIZE_MAX_FD  16384 //最大fd连接数
 #endif
 
+#ifndef EC_VFD_SLOTBITS
+#define EC_VFD_SLOTBITS 14 // kfd低位的槽位号位数, kfd = (gen << EC_VFD_SLOTBITS) | slot
+#endif
+#if ((1 << EC_VFD_SLOTBITS) < SIZE_MAX_FD) || (EC_VFD_SLOTBITS > 24)
+#error "EC_VFD_SLOTBITS must satisfy (1 << EC_VFD_SLOTBITS) >= SIZE_MAX_FD and EC_VFD_SLOTBITS <= 24"
+#endif
+#define EC_VFD_SLOTMASK ((1 << EC_VFD_SLOTBITS) - 1)
+#define EC_VFD_GENMAX (INT32_MAX >> EC_VFD_SLOTBITS) // 最大代号
+
+#ifndef EC_VFD_SAVESTEP
+#define EC_VFD_SAVESTEP 256 // 可持续fd文件中保存的代号比已用的最大代号预留这么多组
+#endif
+
 class netio_linux
 {
 public:
@@ -50,64 +95,184 @@ public:
 		fd_tcpout,
 		fd_listen,
 		fd_epoll,
-		fd_udp
+		fd_udp,
+		fd_event
 	};
 
 	struct t_fd
 	{
-		int  kfd;
+		int  kfd; // 0:空闲槽位
 		int  fdtype;
-		int  sysfd; //>=0;  <0 error
+		int  sysfd; //>=0;  <0 error; 空闲槽位时为下一个空闲槽位号
 		uint32_t pollevents;
+		void* puser; // 应用层关联对象,如session
 	};
 
-	struct keq_fd
+	/**
+	 * @brief 虚拟fd表, kfd = (gen << EC_VFD_SLOTBITS) | slot, 由槽位号直接索引;
+	 * 槽位释放后按FIFO重用, 每个槽位的代号各自递增, 同一槽位重用EC_VFD_GENMAX/step次内已关闭的kfd不会查到新连接。
+	*/
+	class fdtable_
 	{
-		bool operator()(int key, const t_fd& val)
+	public:
+		class iterator
 		{
-			return key == val.kfd;
+			t_fd* _p;
+			t_fd* _pend;
+			void skip_() {
+				while (_p < _pend && !_p->kfd)
+					++_p;
+			}
+		public:
+			iterator(t_fd* p, t_fd* pend) : _p(p), _pend(pend) {
+				skip_();
+			}
+			t_fd& operator*() {
+				return *_p;
+			}
+			iterator& operator++() {
+				++_p;
+				skip_();
+				return *this;
+			}
+			bool operator!=(const iterator& v) const {
+				return _p != v._p;
+			}
+		};
+	private:
+		ec::vector<t_fd> _slots;
+		int _freehead, _freetail; // 空闲槽位FIFO链表
+		size_t _size;
+	public:
+		fdtable_() : _freehead(-1), _freetail(-1), _size(0) {
+			_slots.reserve(SIZE_MAX_FD < 1024 ? SIZE_MAX_FD : 1024);
+		}
+		inline size_t size() const {
+			return _size;
+		}
+		inline t_fd* get(int kfd) {
+			int slot = kfd & EC_VFD_SLOTMASK;
+			if (kfd <= 0 || slot >= (int)_slots.size() || _slots[slot].kfd != kfd)
+				return nullptr;
+			return &_slots[slot];
+		}
+		inline bool has(int kfd) {
+			return nullptr != get(kfd);
+		}
+		int peekslot() const // 下一个可用的槽位号, -1:满
+		{
+			if (_freehead >= 0)
+				return _freehead;
+			return _slots.size() < SIZE_MAX_FD ? (int)_slots.size() : -1;
+		}
+		bool set(const t_fd& t) // 占用peekslot()返回的槽位或更新已有的kfd
+		{
+			int slot = t.kfd & EC_VFD_SLOTMASK;
+			if (t.kfd <= 0)
+				return false;
+			if (slot < (int)_slots.size() && _slots[slot].kfd == t.kfd) {
+				_slots[slot] = t;
+				return true;
+			}
+			if (slot == _freehead) {
+				_freehead = _slots[slot].sysfd;
+				if (_freehead < 0)
+					_freetail = -1;
+				_slots[slot] = t;
+			}
+			else if (slot == (int)_slots.size() && _slots.size() < SIZE_MAX_FD)
+				_slots.push_back(t);
+			else
+				return false;
+			++_size;
+			return true;
+		}
+		bool erase(int kfd)
+		{
+			t_fd* p = get(kfd);
+			if (!p)
+				return false;
+			int slot = kfd & EC_VFD_SLOTMASK;
+			p->kfd = 0;
+			p->sysfd = -1;
+			p->puser = nullptr;
+			if (_freetail >= 0)
+				_slots[_freetail].sysfd = slot;
+			else
+				_freehead = slot;
+			_freetail = slot;
+			--_size;
+			return true;
+		}
+		void clear()
+		{
+			_slots.clear();
+			_freehead = -1;
+			_freetail = -1;
+			_size = 0;
+		}
+		iterator begin() {
+			return iterator(_slots.data(), _slots.data() + _slots.size());
+		}
+		iterator end() {
+			return iterator(_slots.data() + _slots.size(), _slots.data() + _slots.size());
 		}
 	};
 
 private:
-	int _nextfd;
+	int _genstart; // 新槽位的起始代号, 可持续fd时从文件读取
+	int _genreserved; // 可持续fd文件中已预留的代号, 分配的代号超过时重写文件
+	int _fdbase, _fdstep; // gen % _fdstep == _fdbase, 多reactor时各自的fd不重叠
+	ec::vector<int> _slotgens; // 每个槽位上次分配的代号
 	int _sizercvbuf, _sizesndbuf; // kbytes
-	ec::hashmap<int, t_fd, keq_fd> _mapfd;
+	fdtable_ _mapfd;
 	ec::string _sfdfile;
 
-	int nextfd()
+	void savegen_(int gennew) // 代号超过预留值时按批预留代号写可持续fd文件
 	{
-		if (_mapfd.size() >= SIZE_MAX_FD)
-			return -1;
-		do {
-			++_nextfd;
-			if (_nextfd == INT32_MAX)
-				_nextfd = 1;
-		} while (_mapfd.has(_nextfd));
-		if (!_sfdfile.empty()) {
-			FILE* pf = ec::io::fopen(_sfdfile.c_str(), "wt");
-			if (pf) {
-				char sid[40] = { 0 };
-				snprintf(sid, sizeof(sid), "%d", _nextfd);
-				fwrite(sid, 1, strlen(sid), pf);
-				fclose(pf);
-			}
+		if (_sfdfile.empty() || gennew <= _genreserved)
+			return;
+		int64_t gen = gennew + (int64_t)EC_VFD_SAVESTEP * _fdstep;
+		_genreserved = gen > EC_VFD_GENMAX ? EC_VFD_GENMAX : (int)gen;
+		FILE* pf = ec::io::fopen(_sfdfile.c_str(), "wt");
+		if (pf) {
+			char sid[40] = { 0 };
+			snprintf(sid, sizeof(sid), "%d", gen > EC_VFD_GENMAX ? 0 : (int)gen);
+			fwrite(sid, 1, strlen(sid), pf);
+			fclose(pf);
 		}
-		return _nextfd;
 	}
 
-	void setfd(int kfd, fdtype type, int sysfd)
+	int nextfd()
+	{
+		int slot = _mapfd.peekslot();
+		if (slot < 0)
+			return -1;
+		while ((int)_slotgens.size() <= slot)
+			_slotgens.push_back(_genstart);
+		int gen = (_slotgens[slot] / _fdstep + 1) * _fdstep + _fdbase;
+		if (gen > EC_VFD_GENMAX)
+			gen = _fdbase ? _fdbase : _fdstep;
+		_slotgens[slot] = gen;
+		savegen_(gen);
+		return (gen << EC_VFD_SLOTBITS) | slot;
+	}
+
+	void setfd(int kfd, fdtype type, int sysfd, bool bcloexec = false) // bcloexec: sysfd已设置FD_CLOEXEC
 	{
 		t_fd t;
-		int flags = fcntl(sysfd, F_GETFD);
-		flags |= FD_CLOEXEC;
-		fcntl(sysfd, F_SETFD, flags);
+		if (!bcloexec) {
+			int flags = fcntl(sysfd, F_GETFD);
+			flags |= FD_CLOEXEC;
+			fcntl(sysfd, F_SETFD, flags);
+		}
 
 		t.kfd = kfd;
 		t.fdtype = type;
 		t.sysfd = sysfd;
 		t.pollevents = 0;
-		_mapfd.set(kfd, t);
+		t.puser = nullptr;
+		_mapfd.set(t);
 	}
 
 	bool socketfull()
@@ -116,6 +281,27 @@ private:
 	}
 
 public:
+	/**
+	 * @brief 设置fd分组, 分配的kfd代号满足 gen % step == base, 用于多reactor时由kfd定位所属reactor
+	 * @param base 组号 0 - step-1
+	 * @param step 组数
+	*/
+	void setfdstep(int base, int step)
+	{
+		if (step < 1 || base < 0 || base >= step)
+			return;
+		_fdbase = base;
+		_fdstep = step;
+	}
+
+	/**
+	 * @brief 返回kfd所属的组号
+	*/
+	static int fdgroup(int kfd, int step)
+	{
+		return step > 1 ? (kfd >> EC_VFD_SLOTBITS) % step : 0;
+	}
+
 	void SetFdFile(const char* sfile)
 	{
 		if (!sfile || !*sfile) {
@@ -129,20 +315,40 @@ public:
 		if (pf) {
 			char sid[40] = { 0 };
 			if(fread(sid, 1, sizeof(sid) - 1u, pf) > 0)
-				_nextfd = atoi(sid);
+				_genstart = atoi(sid);
 			fclose(pf);
-			if (_nextfd < 0)
-				_nextfd = 0;
+			if (_genstart < 0 || _genstart > EC_VFD_GENMAX)
+				_genstart = 0;
 		}
+		_genreserved = _genstart; // 下次分配时预留并写文件
 	}
 	inline int geterrno() {
 		return errno;
 	}
-	ec::hashmap<int, t_fd, keq_fd>& getmap() {
+	fdtable_& getmap() {
 		return _mapfd;
 	}
+
+	/**
+	 * @brief 设置kfd关联的应用层对象
+	 * @return 0:ok; -1:kfd不存在
+	*/
+	inline int setuser(int kfd, void* puser)
+	{
+		t_fd* p = _mapfd.get(kfd);
+		if (!p)
+			return -1;
+		p->puser = puser;
+		return 0;
+	}
+
+	inline void* getuser(int kfd)
+	{
+		t_fd* p = _mapfd.get(kfd);
+		return p ? p->puser : nullptr;
+	}
 public:
-	netio_linux() :_nextfd(0), _sizercvbuf(128), _sizesndbuf(128), _mapfd(1024)
+	netio_linux() :_genstart(0), _genreserved(0), _fdbase(0), _fdstep(1), _sizercvbuf(128), _sizesndbuf(128)
 	{
 	}
 	~netio_linux() {
@@ -203,6 +409,25 @@ public:
 		return kfd;
 	}
 
+	/**
+	 * @brief 创建用于跨线程唤醒epoll的eventfd
+	 * @param psysfd 输出系统fd, 其他线程用它write唤醒
+	 * @return kfd; -1:error
+	*/
+	int eventfd_create_(int* psysfd)
+	{
+		int kfd = nextfd();
+		if (kfd < 0)
+			return -1;
+		int sysfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (sysfd < 0)
+			return -1;
+		setfd(kfd, fd_event, sysfd);
+		if (psysfd)
+			*psysfd = sysfd;
+		return kfd;
+	}
+
 	inline int epoll_ctl_(int epfd, int op, int fd, struct epoll_event* event)
 	{
 		t_fd* pepoll = _mapfd.get(epfd);
@@ -239,6 +464,16 @@ public:
 		return 0;
 	}
 
+	inline int detach_(int fd) //close one fd without shutdown, 连接已交接给其他进程; return 0:success; -1:fd not exist
+	{
+		t_fd* p = _mapfd.get(fd);
+		if (!p)
+			return -1;
+		close(p->sysfd);
+		_mapfd.erase(fd);
+		return 0;
+	}
+
 	int connect_asyn(const struct sockaddr* addr, socklen_t addrlen) //connect nobloack, return fd
 	{
 		int sysfd, kfd = nextfd();
@@ -259,7 +494,7 @@ public:
 		return kfd;
 	}
 
-	int bind_listen(const struct sockaddr* addr, socklen_t addrlen, int ipv6only = 0) // bind and listen return fd
+	int bind_listen(const struct sockaddr* addr, socklen_t addrlen, int ipv6only = 0, int reuseport = 0) // bind and listen return fd
 	{
 		int sysfd, kfd = nextfd();
 		if (kfd < 0)
@@ -279,6 +514,15 @@ public:
 			close(sysfd);
 			return -1;
 		}
+		if (reuseport) { // 多个reactor监听同一端口，由内核分发连接
+			opt = 1;
+			if (-1 == setsockopt(sysfd, SOL_SOCKET, SO_REUSEPORT, (const void*)&opt, sizeof(opt))) {
+				close(sysfd);
+				return -1;
+			}
+		}
+		ec::net::setrecvbuf(sysfd, _sizercvbuf * 1024); // accept的连接继承监听socket的收发缓冲设置
+		ec::net::setsendbuf(sysfd, _sizesndbuf * 1024);
 		if (bind(sysfd, addr, addrlen) < 0 || listen(sysfd, SOMAXCONN) < 0) {
 			close(sysfd);
 			return -1;
@@ -316,22 +560,43 @@ public:
 		return kfd;
 	}
 
-	inline int accept_(int fd, struct sockaddr* addr, socklen_t* addrlen) // return fd
+	/**
+	 * @brief 接受一个连接, 使用accept4一次设置非阻塞和FD_CLOEXEC
+	 * @return 返回fd; -1:失败, errno为EAGAIN/EWOULDBLOCK表示已无待接受的连接
+	 */
+	inline int accept_(int fd, struct sockaddr* addr, socklen_t* addrlen)
 	{
 		t_fd* p = _mapfd.get(fd);
-		if (!p || fd_listen != p->fdtype)
+		if (!p || fd_listen != p->fdtype) {
+			errno = EBADF;
 			return -1;
-		int sysfd = accept(p->sysfd, addr, addrlen);
+		}
+		int sysfd = accept4(p->sysfd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
 		if (sysfd < 0)
 			return -1;
 		int kfd = nextfd();
 		if (kfd < 0) {
 			close(sysfd);
+			errno = EMFILE;
 			return -1;
 		}
-		ec::net::setrecvbuf(sysfd, _sizercvbuf * 1024);
-		ec::net::setsendbuf(sysfd, _sizesndbuf * 1024);
-		setfd(kfd, fd_tcp, sysfd);
+		setfd(kfd, fd_tcp, sysfd, true);
+		return kfd;
+	}
+
+	/**
+	 * @brief 登记外部已创建的系统fd(如io_uring multishot accept得到的连接)
+	 * @return 返回kfd; -1:fd表满, 已关闭sysfd
+	 */
+	int attach_(int sysfd, fdtype type, bool bcloexec = false)
+	{
+		int kfd = nextfd();
+		if (kfd < 0) {
+			close(sysfd);
+			errno = EMFILE;
+			return -1;
+		}
+		setfd(kfd, type, sysfd, bcloexec);
 		return kfd;
 	}
 
@@ -351,6 +616,46 @@ public:
 		return send(p->sysfd, buf, len, flags);
 	}
 	
+	/**
+	 * @brief 设置SO_ZEROCOPY, 之后可以使用MSG_ZEROCOPY发送
+	 * @return 0:ok; -1:error(内核不支持)
+	*/
+	int setzerocopy(int fd)
+	{
+		int on = 1;
+		t_fd* p = _mapfd.get(fd);
+		if (!p || (fd_tcp != p->fdtype && fd_tcpout != p->fdtype))
+			return -1;
+		return setsockopt(p->sysfd, SOL_SOCKET, SO_ZEROCOPY, &on, (socklen_t)sizeof(on));
+	}
+
+	/**
+	 * @brief 读socket错误队列, 用于读取MSG_ZEROCOPY完成通知
+	*/
+	inline int recverrq_(int fd, struct msghdr* msg)
+	{
+		t_fd* p = _mapfd.get(fd);
+		if (!p || (fd_tcp != p->fdtype && fd_tcpout != p->fdtype))
+			return -1;
+		return (int)recvmsg(p->sysfd, msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+	}
+
+	/**
+	 * @brief scatter-gather发送, 使用sendmsg一次发送多个数据块
+	 * @return 发送的字节数; -1:error
+	*/
+	inline int sendv_(int fd, const struct iovec* iov, int iovcnt, int flags)
+	{
+		t_fd* p = _mapfd.get(fd);
+		if (!p || (fd_tcp != p->fdtype && fd_tcpout != p->fdtype))
+			return -1;
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = (struct iovec*)iov;
+		msg.msg_iovlen = iovcnt;
+		return (int)sendmsg(p->sysfd, &msg, flags);
+	}
+
 	inline int shutdown_(int fd, int how)
 	{
 		t_fd* p = _mapfd.get(fd);
@@ -396,6 +701,35 @@ public:
 		return 0;
 	}
 
+	/**
+	 * @brief 设置SO_BUSY_POLL, 阻塞读或epoll时忙轮询网卡队列的微秒数, 超过net.core.busy_read需要CAP_NET_ADMIN
+	 * @return 0:ok; -1:error
+	*/
+	int setbusypoll(int fd, int us)
+	{
+		t_fd* p = _mapfd.get(fd);
+		if (!p || (fd_tcp != p->fdtype && fd_tcpout != p->fdtype && fd_udp != p->fdtype))
+			return -1;
+#ifdef SO_BUSY_POLL
+		return setsockopt(p->sysfd, SOL_SOCKET, SO_BUSY_POLL, (char*)&us, sizeof(us));
+#else
+		errno = ENOPROTOOPT;
+		return -1;
+#endif
+	}
+
+	/**
+	 * @brief 设置IPPROTO_TCP层的整数选项, 如TCP_NOTSENT_LOWAT,TCP_CORK,TCP_QUICKACK; 监听fd可设置TCP_DEFER_ACCEPT,TCP_FASTOPEN
+	 * @return 0:ok; -1:error
+	*/
+	int settcpopt(int fd, int opt, int v)
+	{
+		t_fd* p = _mapfd.get(fd);
+		if (!p || (fd_tcp != p->fdtype && fd_tcpout != p->fdtype && fd_listen != p->fdtype))
+			return -1;
+		return setsockopt(p->sysfd, IPPROTO_TCP, opt, (char*)&v, sizeof(v));
+	}
+
 	int tcpnodelay(int fd)
 	{
 		t_fd* p = _mapfd.get(fd);
@@ -458,6 +792,22 @@ public:
 		return sendto(p->sysfd, buf, len, MSG_DONTWAIT, dest_addr, addrlen);
 	}
 
+	inline int recvmmsg_(int fd, struct mmsghdr* msgvec, unsigned int vlen)
+	{
+		t_fd* p = _mapfd.get(fd);
+		if (!p || fd_udp != p->fdtype)
+			return -1;
+		return recvmmsg(p->sysfd, msgvec, vlen, MSG_DONTWAIT, nullptr);
+	}
+
+	inline int sendmmsg_(int fd, struct mmsghdr* msgvec, unsigned int vlen)
+	{
+		t_fd* p = _mapfd.get(fd);
+		if (!p || fd_udp != p->fdtype)
+			return -1;
+		return sendmmsg(p->sysfd, msgvec, vlen, MSG_DONTWAIT);
+	}
+
 	int setsendbuf(int fd, int n)
 	{
 		int nval = n;
@@ -0,0 +1,250 @@
+﻿/*!
+\file ec_aioreactors.h
+
+multi-reactor for ec::aio::netserver (linux only)
+
+每个reactor一个线程和一个epoll, 使用SO_REUSEPORT监听同一端口, 由内核分配新连接;
+每个reactor分配的kfd不重叠(netio_linux::fdgroup(kfd, size()) == reactor序号), 可以由fd找到所属reactor。
+跨线程发送使用sendtofd(), 会投递到所属reactor的线程中发送。
+
+\author  jiangyong
+\update
+  2026-10-16 增加bindnuma(), reactor线程绑定到NUMA节点, 发送缓冲等系统内存分配在本节点
+  2026-10-16 first version
+
+eclib 4.0 Copyright (c) 2017-2024, kipway
+source repository : https://github.com/kipway
+
+Licensed under the Apache License, Version 2.0 (the "License");
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+*/
+
+#pragma once
+#ifndef _WIN32
+#include <sched.h>
+#include <stdio.h>
+#include "ec_aiosrv.h"
+#include "ec_thread.h"
+#include "ec_vector.hpp"
+
+namespace ec {
+	namespace aio {
+		/**
+		 * @brief 多reactor, _SRV为ec::aio::netserver的派生类
+		 * @code
+		 *	ec::aio::reactors<myserver> rs;
+		 *	rs.create(4, &log);
+		 *	rs.tcplisten(8080);
+		 *	rs.start();
+		 *	...
+		 *	rs.stop();
+		 * @endcode
+		*/
+		template<class _SRV>
+		class reactors
+		{
+		protected:
+			class worker : public ec::thread
+			{
+			public:
+				_SRV* _psrv;
+				int _waitmsec;
+				int _numanode; // -1:不绑定
+				bool _bound;
+				worker(_SRV* psrv) : _psrv(psrv), _waitmsec(100), _numanode(-1), _bound(false) {
+				}
+			protected:
+				virtual void threadRuntime()
+				{
+					if (!_bound) {
+						_bound = true;
+						if (_numanode >= 0)
+							bindnode_(_numanode);
+					}
+					int64_t curmsec = 0;
+					_psrv->runtime(_waitmsec, curmsec);
+				}
+			};
+			ec::vector<_SRV*> _srvs;
+			ec::vector<worker*> _workers;
+			int _numanodes; // >0:reactor i绑定到节点i % _numanodes
+
+			/**
+			 * @brief 读取/sys/devices/system/node下的cpu列表, 如"0-15,32-47"
+			 * @return 0:ok; -1:error
+			*/
+			static int nodecpus_(int node, cpu_set_t* pset)
+			{
+				char sfile[80], sbuf[1024];
+				snprintf(sfile, sizeof(sfile), "/sys/devices/system/node/node%d/cpulist", node);
+				FILE* pf = fopen(sfile, "r");
+				if (!pf)
+					return -1;
+				size_t n = fread(sbuf, 1, sizeof(sbuf) - 1, pf);
+				fclose(pf);
+				sbuf[n] = 0;
+				CPU_ZERO(pset);
+				char* ps = sbuf, * pe;
+				int nl, nh, ncpus = 0;
+				while (*ps >= '0' && *ps <= '9') {
+					nl = (int)strtol(ps, &pe, 10);
+					nh = nl;
+					if ('-' == *pe)
+						nh = (int)strtol(pe + 1, &pe, 10);
+					for (; nl <= nh && nl < CPU_SETSIZE; nl++, ncpus++)
+						CPU_SET(nl, pset);
+					ps = (',' == *pe) ? pe + 1 : pe;
+				}
+				return ncpus ? 0 : -1;
+			}
+
+			/**
+			 * @brief 当前线程绑定到节点的CPU, 之后分配的系统内存优先在该节点
+			*/
+			static void bindnode_(int node)
+			{
+				cpu_set_t cpus;
+				if (!nodecpus_(node, &cpus))
+					sched_setaffinity(0, sizeof(cpus), &cpus);
+#ifdef _HAS_EC_ALLOCTOR
+				ec::blk_numa_setnode(node);
+#endif
+			}
+		public:
+			reactors() : _numanodes(0) {
+			}
+			virtual ~reactors() {
+				destroy();
+			}
+
+			/**
+			 * @brief 创建并打开num个reactor, args为_SRV构造参数
+			 * @return 0:ok; -1:error
+			*/
+			template<class... _Args>
+			int create(int num, _Args&&... args)
+			{
+				if (num < 1 || !_srvs.empty())
+					return -1;
+				_srvs.reserve(num);
+				for (int i = 0; i < num; i++) {
+					_SRV* psrv = new _SRV(args...);
+					psrv->setfdstep(i, num);
+					_srvs.push_back(psrv);
+					if (psrv->open() < 0) {
+						destroy();
+						return -1;
+					}
+				}
+				return 0;
+			}
+
+			/**
+			 * @brief 停止线程, 关闭并删除所有reactor
+			*/
+			void destroy()
+			{
+				stop();
+				for (auto& i : _srvs) {
+					i->close();
+					delete i;
+				}
+				_srvs.clear();
+			}
+
+			/**
+			 * @brief 每个reactor以SO_REUSEPORT监听同一端口, 需在start()前调用
+			 * @return 0:ok; -1:error
+			*/
+			int tcplisten(uint16_t port, const char* sip = nullptr, int ipv6only = 0)
+			{
+				if (_srvs.empty())
+					return -1;
+				for (auto& i : _srvs) {
+					if (i->tcplisten(port, sip, ipv6only, 1) < 0)
+						return -1;
+				}
+				return 0;
+			}
+
+			/**
+			 * @brief 多路服务器上将reactor线程依次绑定到各NUMA节点, 需在start()前调用.
+			 * 线程内分配的发送缓冲堆等按首次访问分配在本节点, 定义EC_ALLOCTOR_NUMA时使用mbind指定.
+			 * @return NUMA节点数; 0:单节点,不绑定
+			*/
+			int bindnuma()
+			{
+				int n = 0;
+				cpu_set_t cpus;
+				while (n < 64 && !nodecpus_(n, &cpus))
+					++n;
+				_numanodes = n > 1 ? n : 0;
+				return _numanodes;
+			}
+
+			/**
+			 * @brief 启动reactor线程, 每个reactor一个线程
+			*/
+			bool start(int waitmsec = 100)
+			{
+				if (!_workers.empty())
+					return true;
+				_workers.reserve(_srvs.size());
+				for (auto& i : _srvs) {
+					worker* pw = new worker(i);
+					pw->_waitmsec = waitmsec;
+					if (_numanodes > 0)
+						pw->_numanode = (int)_workers.size() % _numanodes;
+					_workers.push_back(pw);
+					if (!pw->threadStart()) {
+						stop();
+						return false;
+					}
+				}
+				return true;
+			}
+
+			void stop()
+			{
+				for (auto& i : _workers) {
+					i->threadStop();
+					delete i;
+				}
+				_workers.clear();
+			}
+
+			inline int size() const
+			{
+				return (int)_srvs.size();
+			}
+
+			inline _SRV* at(int i)
+			{
+				return (i >= 0 && i < (int)_srvs.size()) ? _srvs[i] : nullptr;
+			}
+
+			/**
+			 * @brief 返回fd所属reactor
+			*/
+			inline _SRV* getreactor(int fd)
+			{
+				if (fd < 0 || _srvs.empty())
+					return nullptr;
+				return _srvs[netio_linux::fdgroup(fd, (int)_srvs.size())];
+			}
+
+			/**
+			 * @brief 线程安全发送, 投递到fd所属reactor线程中发送
+			 * @return 0:已投递; -1:error
+			*/
+			int sendtofd(int fd, const void* pdata, size_t size)
+			{
+				_SRV* psrv = getreactor(fd);
+				if (!psrv)
+					return -1;
+				return psrv->postsend_from_any_thread(fd, pdata, size);
+			}
+		};
+	}// namespace aio
+}// namespace ec
+#endif // _WIN32
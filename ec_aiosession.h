@@ -5,6 +5,20 @@ Asynchronous session base class
 
 \author  jiangyong
 \update
+  2026-10-16 ~session()中的MSG_ZEROCOPY引用只在服务整体关闭时释放, 关闭连接时由serverepoll_延迟释放
+  2026-10-16 增加exportstate(),importstate(), 热重启交接会话状态
+  2026-10-16 增加TCP调优配置t_tcptune和会话_tcpcork
+  2026-10-16 增加EC_AIO_PROFILE事件循环耗时统计t_aioprofile和会话_usrecv
+  2026-10-16 增加令牌桶限速t_tokenbucket,t_ratelimit
+  2026-10-16 增加发送缓冲高低水位_sndhigh,_sndlow,_sndpaused
+  2026-10-16 增加延迟直方图t_lathist
+  2026-10-16 增加_rdready,标识在doRecvBuffer就绪列表中
+  2026-10-16 增加_tmdelay, _tmidle, _time_active用于时间轮定时的延迟断开和空闲超时
+  2026-10-16 增加recvinplace(),EC_AIO_RECV_INPLACE模式下直接读入_rbuf
+  2026-10-16 增加广播帧缓存bcframes和sendasyn_bc()
+  2026-10-16 增加引用缓冲发送sendasyn_ref()和MSG_ZEROCOPY完成跟踪
+  2026-10-16 增加udp_rfrm_,用于UDP批量接收回调
+  2026-10-16 增加_etflags, _epollevents用于缓存已注册的epoll事件
   2024.11.9 support no ec_alloctor
   2024-5-15 增加高优先级会话处理。
   2024-5-8 添加会话onClose接口,处理websocket协议断开握手控制帧。
@@ -29,6 +43,10 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #define EC_AIO_READONCE_SIZE (1024 * 14)
 #endif
 
+#ifndef EC_AIO_RECV_INPLACE
+#define EC_AIO_RECV_INPLACE 0 // 1:recvinplace()为true的会话直接读入_rbuf尾部,在_rbuf中解析,省去中间拷贝
+#endif
+
 #ifndef EC_AIO_SNDBUF_BLOCKSIZE
 #define EC_AIO_SNDBUF_BLOCKSIZE (1024 * 64) // 64K
 #endif
@@ -41,6 +59,14 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #define EC_AIO_SNDBUF_MAXSIZE (1024 * 1024 * 32) // 32M
 #endif
 
+#ifndef EC_AIO_SNDBUF_HIGHWATER
+#define EC_AIO_SNDBUF_HIGHWATER (EC_AIO_SNDBUF_MAXSIZE / 2) // 发送缓冲高水位, 0:不启用
+#endif
+
+#ifndef EC_AIO_SNDBUF_LOWWATER
+#define EC_AIO_SNDBUF_LOWWATER (EC_AIO_SNDBUF_MAXSIZE / 8) // 发送缓冲低水位
+#endif
+
 #ifndef EC_AIO_EVTS
 #define EC_AIO_EVTS 16
 #endif
@@ -78,6 +104,18 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #ifndef NETIO_BPS_ITEMS
 #define NETIO_BPS_ITEMS 10 //秒流量计算粒度，每秒数据数。
 #endif
+
+#ifndef EC_AIO_LATENCY_BUCKETS
+#define EC_AIO_LATENCY_BUCKETS 24 // 延迟直方图桶数, 第i桶为小于2^i微秒, 最后一桶包含更大的
+#endif
+
+#ifndef EC_AIO_PROFILE
+#define EC_AIO_PROFILE 0 // 1:统计事件循环等待,事件处理,domessage和接收到发送的耗时, 并记录慢处理日志
+#endif
+
+#ifndef EC_AIO_SLOW_US
+#define EC_AIO_SLOW_US 10000 // 慢处理日志默认阈值微秒
+#endif
 namespace ec {
 	namespace aio {
 
@@ -150,6 +188,68 @@ namespace ec {
 		};
 		using udb_buffer_ = ec::queue<udp_frm_>;
 
+		struct udp_rfrm_ // UDP批量接收的帧,数据和地址只在回调中有效
+		{
+			const void* _pdata;
+			size_t _size;
+			const struct sockaddr* _paddr;
+			int _addrlen;
+		};
+
+		/**
+		 * @brief 广播帧缓存, 同一种编码的帧只生成一次, 各会话发送缓冲引用共享
+		*/
+		class bcframes
+		{
+		public:
+			enum {
+				frm_raw = 0, // 原始数据
+				frm_ws, // websocket 不压缩
+				frm_wsdeflate, // websocket permessage-deflate
+				frm_wsdeflateframe, // websocket x-webkit-deflate-frame
+				frm_max = 8
+			};
+		private:
+			const void* _pdata;
+			size_t _size;
+			ec::refbuf* _frms[frm_max];
+		public:
+			bcframes(const void* pdata, size_t size) : _pdata(pdata), _size(size) {
+				memset(_frms, 0, sizeof(_frms));
+			}
+			~bcframes() {
+				for (auto& i : _frms) {
+					if (i)
+						i->release();
+				}
+			}
+			inline const void* data() const
+			{
+				return _pdata;
+			}
+			inline size_t size() const
+			{
+				return _size;
+			}
+			inline ec::refbuf* get(int kind)
+			{
+				return (kind >= 0 && kind < frm_max) ? _frms[kind] : nullptr;
+			}
+			/**
+			 * @brief 保存生成的帧
+			 * @return 帧的引用缓冲, nullptr:error
+			*/
+			ec::refbuf* set(int kind, const void* pfrm, size_t frmsize)
+			{
+				if (kind < 0 || kind >= frm_max)
+					return nullptr;
+				if (_frms[kind])
+					_frms[kind]->release();
+				_frms[kind] = ec::refbuf::create(pfrm, frmsize);
+				return _frms[kind];
+			}
+		};
+
 		class ssext_data // application session extension data
 		{
 		public:
@@ -195,6 +295,218 @@ namespace ec {
 				return v;
 			}
 		};
+
+		/**
+		 * @brief 延迟直方图, 按微秒log2分桶
+		*/
+		struct t_lathist
+		{
+			uint64_t _buckets[EC_AIO_LATENCY_BUCKETS]; // _buckets[i]: [2^(i-1), 2^i)微秒, _buckets[0]为0微秒
+			uint64_t _count;
+			int64_t _sum; // 总微秒
+			int64_t _max; // 最大微秒
+			t_lathist() {
+				reset();
+			}
+			void reset() {
+				memset(_buckets, 0, sizeof(_buckets));
+				_count = 0;
+				_sum = 0;
+				_max = 0;
+			}
+			void add(int64_t us)
+			{
+				if (us < 0)
+					us = 0;
+				int i = 0;
+				while (i < EC_AIO_LATENCY_BUCKETS - 1 && (us >> i))
+					++i;
+				++_buckets[i];
+				++_count;
+				_sum += us;
+				if (us > _max)
+					_max = us;
+			}
+			int64_t mean() const
+			{
+				return _count ? _sum / (int64_t)_count : 0;
+			}
+
+			/**
+			 * @brief 百分位延迟上限
+			 * @param pct 百分位 0-100, 如99.9
+			 * @return 所在桶的上限微秒数, 不超过_max
+			*/
+			int64_t percentile(double pct) const
+			{
+				if (!_count)
+					return 0;
+				uint64_t n = 0, target = (uint64_t)(_count * pct / 100.0);
+				if (target >= _count)
+					target = _count - 1;
+				for (auto i = 0; i < EC_AIO_LATENCY_BUCKETS - 1; i++) {
+					n += _buckets[i];
+					if (n > target)
+						return ((int64_t)1 << i) < _max ? ((int64_t)1 << i) : _max;
+				}
+				return _max;
+			}
+		};
+
+#if EC_AIO_PROFILE
+		/**
+		 * @brief 事件循环耗时统计
+		*/
+		struct t_aioprofile
+		{
+			t_lathist _wait; // 每次epoll_wait/io_uring_enter/GetQueuedCompletionStatus的等待时间
+			t_lathist _event; // 每个事件(完成项)的处理时间
+			t_lathist _msg; // 每次domessage的时间
+			t_lathist _turn; // 会话最近一次接收到之后第一次发送完成的时间
+			int64_t _slowus = EC_AIO_SLOW_US; // 慢处理阈值, 0:不记录
+			uint64_t _slows = 0; // 慢处理次数
+			void reset()
+			{
+				_wait.reset();
+				_event.reset();
+				_msg.reset();
+				_turn.reset();
+				_slows = 0;
+			}
+			inline bool slow(int64_t us) // 超过阈值返回true
+			{
+				if (_slowus <= 0 || us < _slowus)
+					return false;
+				++_slows;
+				return true;
+			}
+		};
+#endif
+
+		/**
+		 * @brief 令牌桶, 每秒补充_rate个令牌, 最多积累_burst个. 先使用后扣除, 令牌数可为负, 为负时需等待补充.
+		*/
+		struct t_tokenbucket
+		{
+			int64_t _rate; // 每秒令牌数, 0:不限制
+			int64_t _burst; // 桶容量
+			int64_t _tokens; // 当前令牌数
+			int64_t _ustime; // 上次补充的ustime_mono
+			t_tokenbucket() : _rate(0), _burst(0), _tokens(0), _ustime(0) {
+			}
+			void set(int64_t rate, int64_t burst = 0)
+			{
+				_rate = rate > 0 ? rate : 0;
+				_burst = burst > 0 ? burst : _rate;
+				_tokens = _burst;
+				_ustime = ec::ustime_mono();
+			}
+			inline bool enabled() const
+			{
+				return _rate > 0;
+			}
+			int64_t avail(int64_t ustnow) // 补充后的令牌数, 未启用返回INT64_MAX
+			{
+				if (!_rate)
+					return INT64_MAX;
+				int64_t us = ustnow - _ustime, n;
+				if (us <= 0 || _tokens >= _burst)
+					_ustime = ustnow;
+				else if (us >= 10 * 1000 * 1000) { // 超过10秒直接填满, 防止乘法溢出
+					_tokens = _burst;
+					_ustime = ustnow;
+				}
+				else if ((n = us * _rate / 1000000) > 0) {
+					_tokens += n;
+					if (_tokens >= _burst) {
+						_tokens = _burst;
+						_ustime = ustnow;
+					}
+					else
+						_ustime += n * 1000000 / _rate; // 保留不足一个令牌的时间
+				}
+				return _tokens;
+			}
+			inline void consume(int64_t n)
+			{
+				if (_rate)
+					_tokens -= n;
+			}
+			int64_t mswait() const // 令牌数补充到正数还需的毫秒数
+			{
+				if (!_rate || _tokens > 0)
+					return 0;
+				return (1 - _tokens) * 1000 / _rate + 1;
+			}
+		};
+
+		/**
+		 * @brief 限速, 接收字节/秒, 接收消息/秒, 发送字节/秒
+		*/
+		struct t_ratelimit
+		{
+			t_tokenbucket _rcv;
+			t_tokenbucket _msg;
+			t_tokenbucket _snd;
+			void set(int64_t rcvbytes, int64_t rcvmsgs, int64_t sndbytes)
+			{
+				_rcv.set(rcvbytes);
+				_msg.set(rcvmsgs);
+				_snd.set(sndbytes);
+			}
+			inline bool enabled() const
+			{
+				return _rcv.enabled() || _msg.enabled() || _snd.enabled();
+			}
+		};
+
+#define EC_AIO_TCPTUNE_DEFAULT    0 // 不调整
+#define EC_AIO_TCPTUNE_LATENCY    1 // 低延迟: TCP_NODELAY, TCP_QUICKACK, 较小的TCP_NOTSENT_LOWAT
+#define EC_AIO_TCPTUNE_THROUGHPUT 2 // 大吞吐: 较大的TCP_NOTSENT_LOWAT, 多段发送使用TCP_CORK
+#define EC_AIO_TCPTUNE_HTTP       3 // HTTP: TCP_NODELAY, TCP_CORK, TCP_DEFER_ACCEPT, TCP_FASTOPEN
+
+		/**
+		 * @brief 监听端口的TCP调优配置(linux), 连接的选项在accept后设置, 监听socket的选项在settcptune时设置.
+		 * TCP_NOTSENT_LOWAT限制内核中未发出的数据量, 多出的留在_sndbuf中合并发送, 减少内核内存.
+		*/
+		struct t_tcptune
+		{
+			int _nodelay; // 1:TCP_NODELAY
+			int _quickack; // 1:TCP_QUICKACK, 内核不永久保持, 只影响连接开始阶段
+			int _cork; // 1:多段发送(如HTTP头加文件块)时使用TCP_CORK, 发送缓冲发完后取消
+			int _notsentlowat; // TCP_NOTSENT_LOWAT字节数, 0:不设置
+			int _deferaccept; // 监听socket的TCP_DEFER_ACCEPT秒数, 0:不设置
+			int _fastopen; // 监听socket的TCP_FASTOPEN队列长度, 0:不设置
+			t_tcptune(int profile = EC_AIO_TCPTUNE_DEFAULT)
+			{
+				set(profile);
+			}
+			void set(int profile)
+			{
+				memset(this, 0, sizeof(*this));
+				switch (profile) {
+				case EC_AIO_TCPTUNE_LATENCY:
+					_nodelay = 1;
+					_quickack = 1;
+					_notsentlowat = 1024 * 16;
+					break;
+				case EC_AIO_TCPTUNE_THROUGHPUT:
+					_cork = 1;
+					_notsentlowat = 1024 * 128;
+					break;
+				case EC_AIO_TCPTUNE_HTTP:
+					_nodelay = 1;
+					_cork = 1;
+					_notsentlowat = 1024 * 64;
+					_deferaccept = 5;
+					_fastopen = 256;
+					break;
+				default:
+					break;
+				}
+			}
+		};
+
 		class session
 		{
 		public:
@@ -214,11 +526,34 @@ namespace ec {
 			ec::io_buffer<> _sndbuf;
 			char _peerip[48];
 			uint16_t _peerport;
-			uint32_t _epollevents;//epoll events
+			uint32_t _epollevents;//已注册的epoll events, 未变化时不再EPOLL_CTL_MOD
+			uint32_t _etflags;//EPOLLET模式状态标识
 			time_t   _time_error; //延迟断开的开始时间
+			time_t   _time_active; //最后接收数据的时间,用于空闲超时
+			int _tmdelay; //延迟断开定时器id, 0:无
+			int _tmidle; //空闲超时定时器id, 0:无
+			int _rdready; //在doRecvBuffer就绪列表中
 			t_bps   _bpsRcv; //接受秒流量
 			t_bps   _bpsSnd; //发送秒流量
 			size_t _lastsndbufsize;
+			size_t _sndhigh; //发送缓冲高水位, 0:不启用
+			size_t _sndlow; //发送缓冲低水位
+			int _sndpaused; //1:到达高水位后还未降到低水位, 生产者应暂停
+			t_ratelimit _ratelimit; //会话限速
+			int _tmrate; //限速恢复定时器id, 0:无
+			int _tcpcork; //0:不使用TCP_CORK; 1:多段发送时使用; 2:已设置TCP_CORK, 发送缓冲发完后取消
+#if EC_AIO_PROFILE
+			int64_t _usrecv; //最近一次接收的ustime_mono, 发送完成后清零
+#endif
+#ifndef _WIN32
+			struct zcref_ { // 等待内核完成通知的MSG_ZEROCOPY发送
+				uint32_t _seq;
+				ec::refbuf* _pref;
+			};
+			int _zcflag; // MSG_ZEROCOPY, 0:未设置; 1:已启用; -1:不支持
+			uint32_t _zcseq; // 下一个MSG_ZEROCOPY发送序号
+			ec::queue<zcref_> _zcrefs;
+#endif
 		private:
 			ssext_data* _pextdata; //application session extension data
 		public:
@@ -239,8 +574,25 @@ namespace ec {
 				, _sndbuf(EC_AIO_SNDBUF_MAXSIZE, pblkallocator)
 				, _peerport(0)
 				, _epollevents(0)
+				, _etflags(0)
 				, _time_error(0)
+				, _time_active(::time(nullptr))
+				, _tmdelay(0)
+				, _tmidle(0)
+				, _rdready(0)
 				, _lastsndbufsize(-1)
+				, _sndhigh(EC_AIO_SNDBUF_HIGHWATER)
+				, _sndlow(EC_AIO_SNDBUF_LOWWATER)
+				, _sndpaused(0)
+				, _tmrate(0)
+				, _tcpcork(0)
+#if EC_AIO_PROFILE
+				, _usrecv(0)
+#endif
+#ifndef _WIN32
+				, _zcflag(0)
+				, _zcseq(0)
+#endif
 				, _pextdata(nullptr)
 			{
 				memset(_peerip, 0, sizeof(_peerip));
@@ -264,9 +616,28 @@ namespace ec {
 				memcpy(_peerip, v._peerip, sizeof(_peerip));
 				_peerport = v._peerport;
 				_epollevents = v._epollevents;
+				_etflags = v._etflags;
 				_pextdata = v._pextdata;
 				_time_error = v._time_error;
+				_time_active = v._time_active;
+				_tmdelay = v._tmdelay;
+				_tmidle = v._tmidle;
+				_rdready = v._rdready;
 				_lastsndbufsize = v._lastsndbufsize;
+				_sndhigh = v._sndhigh;
+				_sndlow = v._sndlow;
+				_sndpaused = v._sndpaused;
+				_ratelimit = v._ratelimit;
+				_tmrate = v._tmrate;
+				_tcpcork = v._tcpcork;
+#if EC_AIO_PROFILE
+				_usrecv = v._usrecv;
+#endif
+#ifndef _WIN32
+				_zcflag = v._zcflag;
+				_zcseq = v._zcseq;
+				_zcrefs.swap(v._zcrefs);
+#endif
 
 				v._fd = -1;
 				v._status = 0;
@@ -326,12 +697,53 @@ namespace ec {
 				return _sndbuf.append((const uint8_t*)pdata, size) ? (int)size : -1;
 			}
 
+			/**
+			 * @brief 引用缓冲追加到发送缓冲, 不拷贝数据. 重载sendasyn做了编码的派生类需要同时重载此函数
+			 * @return -1:error; or (int)size
+			*/
+			virtual int sendasyn_ref(ec::refbuf* pbuf, ec::ilog* plog)
+			{
+				return _sndbuf.appendref(pbuf, 0, pbuf->size()) ? (int)pbuf->size() : -1;
+			}
+
+			/**
+			 * @brief 广播发送, 默认共享原始数据帧, 使用sendasyn_ref()追加
+			 * @return -1:error; or (int)size
+			*/
+			virtual int sendasyn_bc(bcframes* pfrms, ec::ilog* plog)
+			{
+				ec::refbuf* pf = pfrms->get(bcframes::frm_raw);
+				if (!pf && !(pf = pfrms->set(bcframes::frm_raw, pfrms->data(), pfrms->size())))
+					return -1;
+				return sendasyn_ref(pf, plog);
+			}
+
+#ifndef _WIN32
+			/**
+			 * @brief 内核MSG_ZEROCOPY完成通知, 释放序号不超过seqhi的引用
+			*/
+			void zcdone(uint32_t seqhi)
+			{
+				while (!_zcrefs.empty() && (int32_t)(_zcrefs.front()._seq - seqhi) <= 0) {
+					_zcrefs.front()._pref->release();
+					_zcrefs.pop();
+				}
+			}
+#endif
+
 			virtual ~session()
 			{
 				if (_pextdata) {
 					delete _pextdata;
 					_pextdata = nullptr;
 				}
+#ifndef _WIN32
+				// serverepoll_::closefd()已将未完成的引用移到延迟释放队列, 这里只剩服务整体关闭时的引用
+				while (!_zcrefs.empty()) {
+					_zcrefs.front()._pref->release();
+					_zcrefs.pop();
+				}
+#endif
 			}
 
 			//get udp send buffer
@@ -342,8 +754,20 @@ namespace ec {
 			virtual bool onSendCompleted() { return true; } //return false will disconnected
 			virtual void setHttpDownFile(const char* sfile, long long pos, long long filelen) {};
 			virtual bool hasSendJob() { return false; };
+			/**
+			 * @brief 热重启交接时导出派生类的协议状态, 基本字段由netserver导出
+			 * @return false:有未完成的状态, 不能交接
+			*/
+			virtual bool exportstate(ec::string& so) { return true; }
+			virtual bool importstate(const void* pdata, size_t size) { return true; }
 			virtual void onUdpSendCount(int64_t numfrms, int64_t numbytes) {};
 			virtual int  msglevel() { return 0; } //优先级,每次ec::aio::doRecvBuffer()能处理的消息数
+
+			/**
+			 * @brief 是否直接读入_rbuf, 为true时读到的数据已在_rbuf尾部, 使用onrecvbytes(nullptr, 0, ...)解析;
+			 * 基础TCP会话只在协议判断阶段直接读入, 重载onrecvbytes()的派生类需要同时重载此函数
+			*/
+			virtual bool recvinplace() { return EC_AIO_PROC_TCP == _protocol && EC_AIO_MSG_TCP == _msgtype; }
 			/**
 			 * @brief 断开前处理，用于websocket等断开发送控制码
 			 * @param ncode 状态码
@@ -7,6 +7,26 @@
 * class ec::aio::netserver
 
 * @update
+	2026-10-16 注明handover_listen(),handover_sessions(),handover_import()须在服务线程中调用
+	2026-10-16 onWakeup()用exchange清除_xwake, 避免StoreLoad重排丢失唤醒
+	2026-10-16 再次设置延迟断开时重设定时器, 可以缩短已设置的延迟
+	2026-10-16 onDisconnected()取消会话的空闲,延迟断开和限速定时器
+	2026-10-16 增加热重启交接handover_listen(),handover_sessions(),handover_import()(linux)
+	2026-10-16 增加监听端口TCP调优settcptune(), accept后自动设置; 增加tcpcork(),tcpuncork()
+	2026-10-16 EC_AIO_PROFILE时统计domessage耗时和接收到发送完成的周转时间, 慢处理记录日志
+	2026-10-16 增加指标输出metrics(), JSON或Prometheus文本格式
+	2026-10-16 postsend_from_any_thread()改用无锁MPSC队列,唤醒标志合并eventfd写,反应线程分批取出
+	2026-10-16 增加令牌桶限速setratelimit(),setlistenratelimit(), 令牌不足时暂停读写, 由定时器在补充后恢复
+	2026-10-16 增加发送缓冲高低水位通知onSendHighWater(),onSendLowWater()和生产者暂停查询sendpaused()
+	2026-10-16 增加自适应忙轮询setbusypoll()和跨线程发送延迟直方图latency()
+	2026-10-16 增加io_uring后端, EC_AIOSRV_IOURING为1时使用serveruring_
+	2026-10-16 doRecvBuffer只处理就绪列表中的会话,不再每次扫描全部会话
+	2026-10-16 增加时间轮定时器settimer(),canceltimer(), 延迟断开改用定时器, 增加空闲超时setidletimeout()
+	2026-10-16 onReceived支持已直接读入会话_rbuf的数据(EC_AIO_RECV_INPLACE)
+	2026-10-16 linux下会话查找先从fd表关联的session指针取得
+	2026-10-16 增加广播broadcast(),同类编码的帧只生成一次,各会话引用共享
+	2026-10-16 增加零拷贝发送sendtofd_zc()
+	2026-10-16 增加跨线程发送投递postsend_from_any_thread(),用于多reactor
 	2024-5-15 增加高优先级会话处理。
 	2024-5-8 增加主动断开处理，用于发送websocket断开控制帧。
 	2024-4-29 添加 setSessionDelayDisconnect()
@@ -30,9 +50,28 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #pragma once
 
 #include "ec_aiosession.h"
+#include "ec_timerwheel.h"
+#include "ec_jsonx.h"
+
+#ifndef EC_AIO_TIMER_TICK
+#define EC_AIO_TIMER_TICK 10 // 定时器精度毫秒
+#endif
+
+#define EC_AIO_METRICS_JSON 0 // metrics()输出JSON
+#define EC_AIO_METRICS_PROM 1 // metrics()输出Prometheus文本格式
+
+#ifndef EC_AIO_XMSG_BATCH
+#define EC_AIO_XMSG_BATCH 1024 // 每次唤醒最多处理的跨线程发送消息数
+#endif
+
+#ifndef EC_AIOSRV_IOURING
+#define EC_AIOSRV_IOURING 0 // 1:linux下使用io_uring(需Linux 6.0以上), 0:使用epoll
+#endif
 
 #ifdef _WIN32
 #include "ec_netiocp.h"
+#elif (0 != EC_AIOSRV_IOURING)
+#include "ec_netiouring.h"
 #else
 #include "ec_netepoll.h"
 #endif
@@ -52,6 +91,8 @@ namespace ec {
 	namespace aio {
 #ifdef _WIN32
 		using netserver_ = serveriocp_;
+#elif (0 != EC_AIOSRV_IOURING)
+		using netserver_ = serveruring_;
 #else
 		using netserver_ = serverepoll_;
 #endif
@@ -63,14 +104,76 @@ namespace ec {
 #if (0 != EC_AIOSRV_TLS)
 			ec::tls_srvca _ca;  // certificate
 #endif
-			int64_t _mstimelastdelete = 0;//上次扫描删除连接的时间
+			ec::vector<int> _readyfds; //接收缓冲中可能还有消息的会话, doRecvBuffer中处理
+			ec::vector<int> _readyrun; //doRecvBuffer正在处理的就绪会话
+			ec::timerwheel _timers; //定时器
+			int _idlesec = 0; //空闲超时秒数, 0:不启用
+			int _spinus = 0; //忙轮询微秒数, 0:不启用
+			int _busypollus = 0; //连接的SO_BUSY_POLL微秒数, 0:不设置
+			int64_t _lastactive = 0; //最后一次有事件或消息的ustime_mono
+			t_lathist _latency; //延迟直方图
+			bool _sndwaterrd = false; //true:发送缓冲到达高水位时暂停读取该连接,降到低水位后恢复
+			bool _rlon = false; //已设置限速
+			t_ratelimit _rlglobal; //全局限速
+			struct t_listenlimit_ {
+				int _fdlisten;
+				t_ratelimit _all; //该监听端口所有连接合计
+				t_ratelimit _persession; //该监听端口接入的每个连接
+			};
+			ec::vector<t_listenlimit_> _rllisten; //监听端口限速
+			struct t_listentune_ {
+				int _fdlisten;
+				t_tcptune _tune;
+			};
+			ec::vector<t_listentune_> _tunelisten; //监听端口TCP调优
+			uint64_t _mtaccepts = 0; //累计接入连接数
+			uint64_t _mtmsgs = 0; //累计处理的消息数
+			uint64_t _mtparseerr = 0; //累计解析错误数
+			t_bps _bpsAccept; //每秒接入数
+			t_lathist _mtloop; //每次循环处理耗时(不含等待)
 			uint64_t _allsend = 0 ;//总发送
 			uint64_t _allrecv = 0;//总接收
 			t_bps   _bpsRcv; //总接受秒流量
 			t_bps   _bpsSnd; //总发送秒流量
+#ifndef _WIN32
+			enum hrtype_ {
+				hr_listen = 1,
+				hr_session = 2
+			};
+			struct t_hrfd_ { // 热重启交接记录, 按顺序对应一个系统fd, 会话记录后跟_extsize字节的exportstate()
+				int32_t _type; // hrtype_
+				int32_t _kfd; // 旧进程的fd
+				int32_t _fdlisten; // 会话所属的监听fd(旧进程)
+				int32_t _protocol;
+				uint32_t _udata;
+				uint16_t _port; // 监听端口
+				uint16_t _extsize;
+				int64_t _mstime; // 会话连接时间
+			};
+			struct t_hrlisten_ { // 导入的监听socket
+				int _oldfd;
+				int _fdl;
+				uint16_t _port;
+				bool _claimed; // 已被tcplisten()使用
+			};
+			ec::vector<t_hrlisten_> _hrlistens;
+			struct t_xmsg { // 其他线程投递的发送消息
+				int _fd;
+				int64_t _ustime; // 投递时的ustime_mono
+				ec::bytes _data;
+				t_xmsg() : _fd(-1), _ustime(0) {
+				}
+				t_xmsg(int fd, const void* pdata, size_t size) : _fd(fd), _ustime(ec::ustime_mono()) {
+					_data.append((const uint8_t*)pdata, size);
+				}
+			};
+			ec::mpscqueue<t_xmsg> _xmsgs;
+			std::atomic_bool _xwake{ false }; // 已发出唤醒还未处理, 生产者不再写eventfd
+#endif
 		public:
 			netserver(ec::ilog* plog) : netserver_(plog)
 				, _sndbufblks(EC_AIO_SNDBUF_BLOCKSIZE - EC_ALLOCTOR_ALIGN, EC_AIO_SNDBUF_HEAPSIZE / EC_AIO_SNDBUF_BLOCKSIZE)
+				, _timers(EC_AIO_TIMER_TICK)
 			{
 			}
 			virtual ~netserver() {
@@ -84,6 +187,10 @@ namespace ec {
 			{
 				return _plog;
 			}
+			inline size_t size_sessions() const
+			{
+				return _mapsession.size();
+			}
 #if (0 != EC_AIOSRV_TLS)
 			bool initca(const char* filecert, const char* filerootcert, const char* fileprivatekey)
 			{
@@ -101,29 +208,277 @@ namespace ec {
 				if (!currentmsec)
 					currentmsec = ec::mstime();
 				timerjob(currentmsec);
+				int64_t ust = ec::ustime_mono(), usbusy;
 				int nmsg = doRecvBuffer(); //处理会话接收缓冲中未处理完的消息。
-				netserver_::runtime_(nmsg > 0 ? 0 : waitmsec);
-				if (llabs(currentmsec - _mstimelastdelete) >= 1000) { //每秒扫描一次错误会话
-					_mstimelastdelete = currentmsec;
-					time_t curt = ::time(nullptr);
-					ec::vector<int> dels;
-					dels.reserve(32);
-					for (const auto& i : _mapsession) {
-						if (i->_time_error && llabs(curt - i->_time_error) >= 5) {
-							dels.push_back(i->_fd);
+				usbusy = ec::ustime_mono() - ust;
+				if (nmsg > 0 || !_readyfds.empty() || (_spinus && ust - _lastactive < _spinus))
+					waitmsec = 0;
+				int nevt = netserver_::runtime_(waitmsec);
+				if (nevt > 0 || nmsg > 0) {
+					ust = ec::ustime_mono();
+					_mtloop.add(nevt > 0 ? usbusy + ust - _ustwaitend : usbusy);
+					_lastactive = ust;
+				}
+				_timers.run(ec::mstime_mono(), [this](int id, int fd, int type, ec::timerwheel::callback& cb) {
+					ontimer_(id, fd, type, cb);
+				});
+			}
+
+			/**
+			 * @brief 自适应忙轮询, 用于低延迟场景. 最后一次有事件或消息后的spinus微秒内runtime不阻塞等待, 空闲后恢复阻塞.
+			 * @param spinus 忙轮询微秒数, 0:不启用
+			 * @param busypollus >0时对之后的连接设置SO_BUSY_POLL(linux), 0:不设置
+			*/
+			void setbusypoll(int spinus, int busypollus = 0)
+			{
+				_spinus = spinus > 0 ? spinus : 0;
+				_busypollus = busypollus > 0 ? busypollus : 0;
+			}
+
+			/**
+			 * @brief 延迟直方图, 默认记录postsend_from_any_thread()投递到发送的延迟, 应用可用addlatency()记录自己的
+			*/
+			inline const t_lathist& latency() const
+			{
+				return _latency;
+			}
+
+			inline void addlatency(int64_t us)
+			{
+				_latency.add(us);
+			}
+
+			inline void resetlatency()
+			{
+				_latency.reset();
+			}
+
+#if EC_AIO_PROFILE
+			/**
+			 * @brief 事件循环耗时统计, 只能在runtime线程中访问
+			*/
+			inline const t_aioprofile& profile() const
+			{
+				return _prof;
+			}
+
+			inline void resetprofile()
+			{
+				_prof.reset();
+			}
+
+			/**
+			 * @brief 设置慢处理阈值, 单个事件或domessage超过阈值时输出WRN日志(fd,协议和耗时)
+			 * @param us 微秒, 0:不记录
+			*/
+			inline void setslowhandler(int64_t us)
+			{
+				_prof._slowus = us > 0 ? us : 0;
+			}
+#endif
+
+			/**
+			 * @brief 输出指标, 只能在runtime线程中调用. 会遍历一次会话表统计协议连接数,发送队列分布和接收积压,
+			 * 耗时与连接数成正比, 适合按秒级间隔采集. EC_AIO_PROFILE时同时输出profile()中的耗时统计.
+			 * @param sout 输出, 追加
+			 * @param fmt EC_AIO_METRICS_JSON 或 EC_AIO_METRICS_PROM
+			*/
+			template<class _STR>
+			void metrics(_STR& sout, int fmt = EC_AIO_METRICS_JSON)
+			{
+				static const size_t sqle[] = { 1024, 1024 * 4, 1024 * 16, 1024 * 64, 1024 * 256, 1024 * 1024, 1024 * 1024 * 4, 1024 * 1024 * 16 };
+				const int nle = (int)(sizeof(sqle) / sizeof(size_t));
+				struct t_proto {
+					int _protocol;
+					int _num;
+					const char* _name;
+				};
+				ec::vector<t_proto> protos;
+				uint64_t sqbuckets[sizeof(sqle) / sizeof(size_t) + 1] = { 0 }, sqsum = 0, rbufsum = 0;
+				size_t zs;
+				int i, nrbuf = 0;
+				for (auto& pss : _mapsession) {
+					for (i = 0; i < (int)protos.size(); i++) {
+						if (protos[i]._protocol == pss->_protocol)
+							break;
+					}
+					if (i < (int)protos.size())
+						protos[i]._num++;
+					else
+						protos.push_back(t_proto{ pss->_protocol, 1, pss->ProtocolName(pss->_protocol) });
+					zs = pss->_sndbuf.size();
+					sqsum += zs;
+					for (i = 0; i < nle && zs > sqle[i]; i++)
+						;
+					sqbuckets[i]++;
+					if ((zs = pss->_rbuf.size_()) > 0) {
+						++nrbuf;
+						rbufsum += zs;
+					}
+				}
+				for (i = 1; i <= nle; i++) //累计
+					sqbuckets[i] += sqbuckets[i - 1];
+				int64_t mscur = ec::mstime();
+				char sname[16];
+				if (EC_AIO_METRICS_PROM == fmt) {
+					promvalue_(sout, "ecaio_connections", "gauge", (int64_t)_mapsession.size());
+					promvalue_(sout, "ecaio_fds", "gauge", (int64_t)size_fds());
+					promvalue_(sout, "ecaio_accepts_total", "counter", (int64_t)_mtaccepts);
+					promvalue_(sout, "ecaio_accepts_per_second", "gauge", _bpsAccept.getBps(mscur));
+					promvalue_(sout, "ecaio_recv_bytes_total", "counter", (int64_t)_allrecv);
+					promvalue_(sout, "ecaio_send_bytes_total", "counter", (int64_t)_allsend);
+					promvalue_(sout, "ecaio_recv_bytes_per_second", "gauge", _bpsRcv.getBps(mscur));
+					promvalue_(sout, "ecaio_send_bytes_per_second", "gauge", _bpsSnd.getBps(mscur));
+					promvalue_(sout, "ecaio_messages_total", "counter", (int64_t)_mtmsgs);
+					promvalue_(sout, "ecaio_parse_errors_total", "counter", (int64_t)_mtparseerr);
+					promvalue_(sout, "ecaio_recv_backlog_ready", "gauge", (int64_t)_readyfds.size());
+					promvalue_(sout, "ecaio_recv_backlog_sessions", "gauge", (int64_t)nrbuf);
+					promvalue_(sout, "ecaio_recv_backlog_bytes", "gauge", (int64_t)rbufsum);
+					promtype_(sout, "ecaio_protocol_connections", "gauge");
+					for (auto& pr : protos) {
+						const char* sp = pr._name;
+						if (!sp || !*sp) {
+							snprintf(sname, sizeof(sname), "%d", pr._protocol);
+							sp = sname;
 						}
+						promline_(sout, "ecaio_protocol_connections", "protocol", sp, (int64_t)pr._num);
 					}
-					for (const auto& fd : dels) {
-						_plog->add(CLOG_DEFAULT_INF, "close fd(%d) delayed disconnect.", fd);
-						closefd(fd, 0); //主动断开
+					promtype_(sout, "ecaio_sendqueue_bytes", "histogram");
+					for (i = 0; i < nle; i++) {
+						snprintf(sname, sizeof(sname), "%zu", sqle[i]);
+						promline_(sout, "ecaio_sendqueue_bytes_bucket", "le", sname, (int64_t)sqbuckets[i]);
 					}
+					promline_(sout, "ecaio_sendqueue_bytes_bucket", "le", "+Inf", (int64_t)sqbuckets[nle]);
+					promline_(sout, "ecaio_sendqueue_bytes_sum", nullptr, nullptr, (int64_t)sqsum);
+					promline_(sout, "ecaio_sendqueue_bytes_count", nullptr, nullptr, (int64_t)sqbuckets[nle]);
+					promhist_(sout, "ecaio_loop_us", _mtloop);
+					promhist_(sout, "ecaio_post_latency_us", _latency);
+#if EC_AIO_PROFILE
+					promhist_(sout, "ecaio_wait_us", _prof._wait);
+					promhist_(sout, "ecaio_event_us", _prof._event);
+					promhist_(sout, "ecaio_domessage_us", _prof._msg);
+					promhist_(sout, "ecaio_turnaround_us", _prof._turn);
+					promvalue_(sout, "ecaio_slow_handlers_total", "counter", (int64_t)_prof._slows);
+#endif
+					return;
+				}
+				int nf = 0;
+				sout.push_back('{');
+				ec::js::out_jnumber(nf, "connections", (int64_t)_mapsession.size(), sout, true);
+				ec::js::out_jnumber(nf, "fds", (int64_t)size_fds(), sout, true);
+				ec::js::out_jnumber(nf, "accepts", _mtaccepts, sout, true);
+				ec::js::out_jnumber(nf, "accepts_per_second", _bpsAccept.getBps(mscur), sout, true);
+				ec::js::out_jnumber(nf, "recv_bytes", _allrecv, sout, true);
+				ec::js::out_jnumber(nf, "send_bytes", _allsend, sout, true);
+				ec::js::out_jnumber(nf, "recv_bps", _bpsRcv.getBps(mscur), sout, true);
+				ec::js::out_jnumber(nf, "send_bps", _bpsSnd.getBps(mscur), sout, true);
+				ec::js::out_jnumber(nf, "messages", _mtmsgs, sout, true);
+				ec::js::out_jnumber(nf, "parse_errors", _mtparseerr, sout, true);
+				sout.append(",\"recv_backlog\":{");
+				int nfo = 0;
+				ec::js::out_jnumber(nfo, "ready", (int64_t)_readyfds.size(), sout, true);
+				ec::js::out_jnumber(nfo, "sessions", (int64_t)nrbuf, sout, true);
+				ec::js::out_jnumber(nfo, "bytes", rbufsum, sout, true);
+				sout.append("},\"protocols\":[");
+				i = 0;
+				for (auto& pr : protos) {
+					if (i++)
+						sout.push_back(',');
+					nfo = 0;
+					sout.push_back('{');
+					ec::js::out_jnumber(nfo, "protocol", (int64_t)pr._protocol, sout, true);
+					if (pr._name && *pr._name)
+						ec::js::out_jstring(nfo, "name", pr._name, sout);
+					ec::js::out_jnumber(nfo, "connections", (int64_t)pr._num, sout, true);
+					sout.push_back('}');
 				}
+				sout.append("],\"sendqueue\":{");
+				nfo = 0;
+				ec::js::out_jnumber(nfo, "count", sqbuckets[nle], sout, true);
+				ec::js::out_jnumber(nfo, "sum", sqsum, sout, true);
+				sout.append(",\"buckets\":[");
+				for (i = 0; i < nle; i++) {
+					nfo = 0;
+					sout.append(i ? ",{" : "{");
+					ec::js::out_jnumber(nfo, "le", (uint64_t)sqle[i], sout, true);
+					ec::js::out_jnumber(nfo, "n", sqbuckets[i], sout, true);
+					sout.push_back('}');
+				}
+				sout.append("]}");
+				jsonhist_(sout, "loop_us", _mtloop);
+				jsonhist_(sout, "post_latency_us", _latency);
+#if EC_AIO_PROFILE
+				jsonhist_(sout, "wait_us", _prof._wait);
+				jsonhist_(sout, "event_us", _prof._event);
+				jsonhist_(sout, "domessage_us", _prof._msg);
+				jsonhist_(sout, "turnaround_us", _prof._turn);
+				nf = 1;
+				ec::js::out_jnumber(nf, "slow_handlers", _prof._slows, sout, true);
+#endif
+				sout.push_back('}');
+			}
+
+			/**
+			 * @brief 设置定时器, 到期时在本服务的runtime线程中回调一次
+			 * @param fd 关联的会话fd, 到期时会话已断开则不回调; <0表示不关联会话
+			 * @param msdelay 延时毫秒数, 精度EC_AIO_TIMER_TICK毫秒
+			 * @param cb 回调 void cb(int fd, int timerid)
+			 * @return 定时器id(>0); -1:error
+			*/
+			int settimer(int fd, int msdelay, ec::timerwheel::callback cb)
+			{
+				if (!cb)
+					return -1;
+				return _timers.add(fd, tm_user, msdelay, std::move(cb));
+			}
+
+			/**
+			 * @brief 取消settimer()设置的定时器
+			 * @return true:已取消; false:不存在或已回调
+			*/
+			bool canceltimer(int timerid)
+			{
+				return _timers.cancel(timerid);
+			}
+
+			/**
+			 * @brief 设置空闲超时, 超过指定秒数没有收到数据的会话将断开
+			 * @param seconds 秒数, 0:不启用
+			*/
+			void setidletimeout(int seconds)
+			{
+				int old = _idlesec;
+				_idlesec = seconds > 0 ? seconds : 0;
+				if (!_idlesec || old)
+					return;
+				for (auto& i : _mapsession) //启用时为已有会话设置定时器
+					idletimer_(i);
+			}
+
+			/**
+			 * @brief 查找会话, linux下先从fd表关联的session指针O(1)取得, 取不到再查会话表
+			*/
+			inline bool getsession_(int fd, psession& pss)
+			{
+#ifndef _WIN32
+				if (nullptr != (pss = static_cast<psession>(_net.getuser(fd))))
+					return true;
+#endif
+				return _mapsession.get(fd, pss);
+			}
+
+			inline void setsession_(int fd, psession pss)
+			{
+				_mapsession.set(fd, pss);
+#ifndef _WIN32
+				_net.setuser(fd, pss);
+#endif
 			}
 
 			psession getsession(int fd)
 			{
 				psession pss = nullptr;
-				if (!_mapsession.get(fd, pss))
+				if (!getsession_(fd, pss))
 					return nullptr;
 				return pss;
 			}
@@ -131,7 +486,7 @@ namespace ec {
 			int getsessionstatus(int fd)
 			{
 				psession pss = nullptr;
-				if (!_mapsession.get(fd, pss))
+				if (!getsession_(fd, pss))
 					return -1;
 				return pss->_status;
 			}
@@ -139,7 +494,7 @@ namespace ec {
 			int setsessionstatus(int fd, int st)
 			{
 				psession pss = nullptr;
-				if (!_mapsession.get(fd, pss))
+				if (!getsession_(fd, pss))
 					return -1;
 				pss->_status = st;
 				return 0;
@@ -147,15 +502,16 @@ namespace ec {
 
 			void setSessionDelayDisconnect(int fd, int delaysec = 5) {
 				psession pss = nullptr;
-				if (!_mapsession.get(fd, pss))
+				if (!getsession_(fd, pss))
 					return;
 				pss->_time_error = ::time(nullptr) + delaysec - 5;
+				delaytimer_(pss);
 			}
 
 			int getsessionprotocol(int fd)
 			{
 				psession pss = nullptr;
-				if (!_mapsession.get(fd, pss))
+				if (!getsession_(fd, pss))
 					return -1;
 				return pss->_protocol;
 			}
@@ -163,7 +519,7 @@ namespace ec {
 			int setsessionprotocol(int fd, int protocol)
 			{
 				psession pss = nullptr;
-				if (!_mapsession.get(fd, pss))
+				if (!getsession_(fd, pss))
 					return -1;
 				pss->_protocol = protocol;
 				return 0;
@@ -185,17 +541,367 @@ namespace ec {
 			int waterlevel(int fd)
 			{
 				psession pss = nullptr;
-				if (!_mapsession.get(fd, pss))
+				if (!getsession_(fd, pss))
 					return -1;
 				return pss->_sndbuf.waterlevel();
 			}
 
+			/**
+			 * @brief 设置发送缓冲高低水位, 到达高水位时回调onSendHighWater(), 之后降到低水位时回调onSendLowWater()
+			 * @param fd
+			 * @param high 高水位字节数, 0:不启用
+			 * @param low 低水位字节数, 应小于high
+			 * @return 0:ok; -1:error
+			*/
+			int setsendwater(int fd, size_t high, size_t low)
+			{
+				psession pss = nullptr;
+				if (!getsession_(fd, pss) || (high && low >= high))
+					return -1;
+				pss->_sndhigh = high;
+				pss->_sndlow = low;
+				chksndwater_(fd, pss);
+				return 0;
+			}
+
+			/**
+			 * @brief 发送缓冲到达高水位时是否同时暂停读取该连接, 用于请求应答类协议限流慢速客户端
+			*/
+			void setsendwater_readpause(bool bpause)
+			{
+				_sndwaterrd = bpause;
+			}
+
+			/**
+			 * @brief 设置令牌桶限速, 桶容量为1秒的量, 参数为0表示该项不限制. 令牌不足时暂停读或写, 补充后由定时器恢复.
+			 * @param fd 会话fd:该连接; -1:全局
+			 * @param rcvbytes 接收字节/秒
+			 * @param rcvmsgs 接收消息/秒
+			 * @param sndbytes 发送字节/秒, 仅linux
+			 * @return 0:ok; -1:会话不存在
+			*/
+			int setratelimit(int fd, int64_t rcvbytes, int64_t rcvmsgs, int64_t sndbytes)
+			{
+				psession pss = nullptr;
+				if (fd < 0)
+					_rlglobal.set(rcvbytes, rcvmsgs, sndbytes);
+				else if (getsession_(fd, pss))
+					pss->_ratelimit.set(rcvbytes, rcvmsgs, sndbytes);
+				else
+					return -1;
+				if (rcvbytes > 0 || rcvmsgs > 0 || sndbytes > 0)
+					_rlon = true;
+				return 0;
+			}
+
+			/**
+			 * @brief 设置监听端口的令牌桶限速, 参数同setratelimit
+			 * @param fdlisten 监听fd
+			 * @param bpersession false:该端口所有连接合计; true:之后接入的每个连接
+			*/
+			void setlistenratelimit(int fdlisten, int64_t rcvbytes, int64_t rcvmsgs, int64_t sndbytes, bool bpersession)
+			{
+				t_listenlimit_* pl = listenlimit_(fdlisten);
+				if (!pl) {
+					t_listenlimit_ t;
+					t._fdlisten = fdlisten;
+					_rllisten.push_back(t);
+					pl = &_rllisten[_rllisten.size() - 1];
+				}
+				if (bpersession)
+					pl->_persession.set(rcvbytes, rcvmsgs, sndbytes);
+				else
+					pl->_all.set(rcvbytes, rcvmsgs, sndbytes);
+				if (rcvbytes > 0 || rcvmsgs > 0 || sndbytes > 0)
+					_rlon = true;
+			}
+
+#ifndef _WIN32
+			/**
+			 * @brief TCP监听, 参数同netserver_::tcplisten. 热重启已导入同端口的监听socket时直接使用它.
+			 * @return 监听fd; -1:error
+			*/
+			int tcplisten(uint16_t port, const char* sip = nullptr, int ipv6only = 0, int reuseport = 0)
+			{
+				for (auto& i : _hrlistens) {
+					if (!i._claimed && i._port == port) {
+						i._claimed = true;
+						return i._fdl;
+					}
+				}
+				return netserver_::tcplisten(port, sip, ipv6only, reuseport);
+			}
+
+			/**
+			 * @brief 监听并设置TCP调优配置, 其他参数同tcplisten
+			 * @return 监听fd; -1:error
+			*/
+			int tcplisten(uint16_t port, const t_tcptune& tune, const char* sip = nullptr, int ipv6only = 0, int reuseport = 0)
+			{
+				int fdl = tcplisten(port, sip, ipv6only, reuseport);
+				if (fdl >= 0)
+					settcptune(fdl, tune);
+				return fdl;
+			}
+
+			/**
+			 * @brief 热重启第一步, 旧进程导出TCP监听socket. 交接完成前两个进程都可以accept.
+			 * @param sysfds 输出dup出的系统fd, 发送给新进程后由调用者关闭
+			 * @param so 输出交接记录, 追加
+			 * @return 导出的fd数
+			 * @remark 非线程安全, 须在运行本服务runtime()的线程中调用
+			*/
+			int handover_listen(ec::vector<int>& sysfds, ec::string& so)
+			{
+				int n = 0, fd;
+				t_hrfd_ r;
+				for (auto& i : _net.getmap()) {
+					if (NETIO::fd_listen != i.fdtype)
+						continue;
+					ec::net::socketaddr addr;
+					socklen_t* paddrlen = nullptr;
+					struct sockaddr* paddr = addr.getbuffer(&paddrlen);
+					if (getsockname(i.sysfd, paddr, paddrlen) < 0 || (AF_INET != paddr->sa_family && AF_INET6 != paddr->sa_family))
+						continue;
+					if ((fd = fcntl(i.sysfd, F_DUPFD_CLOEXEC, 0)) < 0)
+						continue;
+					memset(&r, 0, sizeof(r));
+					r._type = hr_listen;
+					r._kfd = i.kfd;
+					r._fdlisten = -1;
+					char sip[48] = { 0 };
+					addr.get(r._port, sip, sizeof(sip));
+					so.append((const char*)&r, sizeof(r));
+					sysfds.push_back(fd);
+					++n;
+				}
+				return n;
+			}
+
+			/**
+			 * @brief 热重启第二步, 新进程启动成功后旧进程调用. 停止accept, 导出空闲会话(收发缓冲为空, 非TLS)并从本进程移除,
+			 * 不断开连接. 未导出的会话留在旧进程继续处理. io_uring后端不支持导出会话.
+			 * @param sysfds 输出dup出的系统fd, 发送给新进程后由调用者关闭
+			 * @param so 输出交接记录, 追加
+			 * @param bsessions false:只停止accept
+			 * @return 导出的会话数
+			 * @remark 非线程安全, 须在运行本服务runtime()的线程中调用
+			*/
+			int handover_sessions(ec::vector<int>& sysfds, ec::string& so, bool bsessions = true)
+			{
+				ec::vector<int> fds;
+				for (auto& i : _net.getmap()) {
+					if (NETIO::fd_listen == i.fdtype)
+						fds.push_back(i.kfd);
+				}
+				for (auto& fdl : fds)
+					pauselisten(fdl);
+				if (!bsessions)
+					return 0;
+				fds.clear();
+				for (auto& pss : _mapsession) {
+					if (pss->_status >= EC_AIO_FD_CONNECTED && !pss->_time_error && !pss->_rdready && pss->_sndbuf.empty()
+						&& !pss->_rbuf.size_() && pss->_zcrefs.empty() && NETIO::fd_tcp == _net.getfdtype(pss->_fd))
+						fds.push_back(pss->_fd);
+				}
+				int n = 0, sysfd;
+				t_hrfd_ r;
+				ec::string ext;
+				psession pss;
+				for (auto& fd : fds) {
+					ext.clear();
+					if (!getsession_(fd, pss) || !pss->exportstate(ext) || ext.size() > UINT16_MAX)
+						continue;
+					if ((sysfd = fcntl(_net.getsysfd(fd), F_DUPFD_CLOEXEC, 0)) < 0)
+						continue;
+					memset(&r, 0, sizeof(r));
+					r._type = hr_session;
+					r._kfd = fd;
+					r._fdlisten = pss->_fdlisten;
+					r._protocol = pss->_protocol;
+					r._udata = pss->_udata;
+					r._extsize = (uint16_t)ext.size();
+					r._mstime = pss->_mstime_connected;
+					if (detachfd(fd) < 0) { // 后端不支持
+						::close(sysfd);
+						break;
+					}
+					so.append((const char*)&r, sizeof(r));
+					so.append(ext.data(), ext.size());
+					sysfds.push_back(sysfd);
+					++n;
+				}
+				_plog->add(CLOG_DEFAULT_MSG, "handover %d sessions, %zu remain", n, _mapsession.size());
+				return n;
+			}
+
+			/**
+			 * @brief 新进程导入旧进程handover_listen()或handover_sessions()的输出. 导入的监听socket在之后同端口的tcplisten()时返回,
+			 * 导入的会话和accept一样调用onAccept(), 非TCP协议的会话由onImportSession()重建.
+			 * @param sysfds 收到的系统fd, 全部由本函数接管
+			 * @param numfds fd数
+			 * @param pstate 交接记录
+			 * @param size 交接记录长度
+			 * @return 导入的fd数
+			 * @remark 非线程安全, 须在运行本服务runtime()的线程中调用, 或者在服务线程启动之前调用
+			*/
+			int handover_import(const int* sysfds, int numfds, const void* pstate, size_t size)
+			{
+				const char* ps = (const char*)pstate, * pend = ps + size, * pext;
+				t_hrfd_ r;
+				int i, n = 0, fd, fdl;
+				psession pss;
+				for (i = 0; i < numfds && ps + sizeof(r) <= pend; i++) {
+					memcpy(&r, ps, sizeof(r));
+					pext = ps + sizeof(r);
+					ps = pext + r._extsize;
+					if (ps > pend)
+						break;
+					if (hr_listen == r._type) {
+						if ((fdl = tcplisten_fd(sysfds[i])) < 0)
+							continue;
+						_hrlistens.push_back(t_hrlisten_{ r._kfd, fdl, r._port, false });
+						_plog->add(CLOG_DEFAULT_MSG, "fd(%d) import listen port %u.", fdl, r._port);
+						++n;
+						continue;
+					}
+					else if (hr_session != r._type) {
+						::close(sysfds[i]);
+						continue;
+					}
+					fdl = -1;
+					for (auto& l : _hrlistens) {
+						if (l._oldfd == r._fdlisten) {
+							fdl = l._fdl;
+							break;
+						}
+					}
+					if ((fd = tcpaccept_fd(sysfds[i], fdl)) < 0 || !getsession_(fd, pss))
+						continue;
+					pss->_udata = r._udata;
+					pss->_mstime_connected = r._mstime;
+					if (EC_AIO_PROC_TCP != r._protocol) {
+						pss = onImportSession(pss, r._protocol);
+						if (!pss || !pss->importstate(pext, r._extsize)) {
+							_plog->add(CLOG_DEFAULT_WRN, "fd(%d) import session protocol %d failed.", fd, r._protocol);
+							closefd(fd, 0);
+							continue;
+						}
+						pss->_protocol = r._protocol;
+						onprotocol(fd, pss->_protocol);
+					}
+					++n;
+				}
+				for (; i < numfds; i++) // 记录不完整
+					::close(sysfds[i]);
+				return n;
+			}
+#else
+			using netserver_::tcplisten;
+
+			int tcplisten(uint16_t port, const t_tcptune& tune, const char* sip = nullptr, int ipv6only = 0)
+			{
+				int fdl = netserver_::tcplisten(port, sip, ipv6only);
+				if (fdl >= 0)
+					settcptune(fdl, tune);
+				return fdl;
+			}
+#endif
+
+			/**
+			 * @brief 设置监听端口的TCP调优配置(linux有效), 监听socket的TCP_DEFER_ACCEPT,TCP_FASTOPEN立即设置,
+			 * 其他选项在之后接入的连接上设置.
+			 * @param fdlisten 监听fd
+			 * @return 0:ok; -1:监听socket选项设置失败, 连接选项仍然生效
+			*/
+			int settcptune(int fdlisten, const t_tcptune& tune)
+			{
+				t_listentune_* pt = nullptr;
+				for (auto& i : _tunelisten) {
+					if (i._fdlisten == fdlisten) {
+						pt = &i;
+						break;
+					}
+				}
+				if (!pt) {
+					_tunelisten.push_back(t_listentune_{ fdlisten, tune });
+					pt = &_tunelisten[_tunelisten.size() - 1];
+				}
+				else
+					pt->_tune = tune;
+				int nr = 0;
+#ifndef _WIN32
+				if (tune._deferaccept > 0 && _net.settcpopt(fdlisten, TCP_DEFER_ACCEPT, tune._deferaccept) < 0) {
+					_plog->add(CLOG_DEFAULT_WRN, "listen fd(%d) set TCP_DEFER_ACCEPT failed, error %d", fdlisten, errno);
+					nr = -1;
+				}
+				if (tune._fastopen > 0 && _net.settcpopt(fdlisten, TCP_FASTOPEN, tune._fastopen) < 0) {
+					_plog->add(CLOG_DEFAULT_WRN, "listen fd(%d) set TCP_FASTOPEN failed, error %d", fdlisten, errno);
+					nr = -1;
+				}
+#endif
+				return nr;
+			}
+
+			/**
+			 * @brief 设置TCP_CORK(linux), 之后的发送只发满包, 发送缓冲发完且无后续发送任务时自动取消;
+			 * 用于HTTP头加文件块等多段发送.
+			 * @return 0:ok; -1:error
+			*/
+			int tcpcork(int fd)
+			{
+#ifndef _WIN32
+				psession pss = nullptr;
+				if (!getsession_(fd, pss))
+					return -1;
+				if (pss->_tcpcork > 1)
+					return 0;
+				if (_net.settcpopt(fd, TCP_CORK, 1) < 0)
+					return -1;
+				pss->_tcpcork = 2;
+				return 0;
+#else
+				return -1;
+#endif
+			}
+
+			/**
+			 * @brief 取消TCP_CORK, 立即发出不满包的剩余数据
+			 * @return 0:ok; -1:error
+			*/
+			int tcpuncork(int fd)
+			{
+#ifndef _WIN32
+				psession pss = nullptr;
+				if (!getsession_(fd, pss))
+					return -1;
+				if (pss->_tcpcork < 2)
+					return 0;
+				pss->_tcpcork = 1;
+				return _net.settcpopt(fd, TCP_CORK, 0);
+#else
+				return -1;
+#endif
+			}
+
+			/**
+			 * @brief 生产者暂停查询
+			 * @return 1:到达高水位还未降到低水位,应暂停生产; 0:可以发送; -1:连接不存在
+			*/
+			int sendpaused(int fd)
+			{
+				psession pss = nullptr;
+				if (!getsession_(fd, pss))
+					return -1;
+				return pss->_sndpaused ? 1 : 0;
+			}
+
 			template<class _ClsPtr>
 			bool getextdata(int fd, const char* clsname, _ClsPtr& ptr)
 			{
 				psession pi = nullptr;
 				ptr = nullptr;
-				if (!_mapsession.get(fd, pi))
+				if (!getsession_(fd, pi))
 					return false;
 				return pi->getextdata(clsname, ptr);
 			}
@@ -203,7 +909,7 @@ namespace ec {
 			bool setextdata(int fd, ssext_data* pdata)
 			{
 				psession pi = nullptr;
-				if (!_mapsession.get(fd, pi))
+				if (!getsession_(fd, pi))
 					return false;
 				pi->setextdata(pdata);
 				return true;
@@ -219,13 +925,87 @@ namespace ec {
 			int sendtofd(int fd, const void* pdata, size_t size)
 			{
 				psession pss = nullptr;
-				if (!_mapsession.get(fd, pss))
+				if (!getsession_(fd, pss))
 					return -1;
 				if(pss->sendasyn(pdata, size, _plog) < 0)
 					return -1;
+				chksndwater_(fd, pss);
+				return postsend(fd);
+			}
+
+			/**
+			 * @brief 广播, 同一种编码的帧(原始数据,websocket各种压缩方式)只生成一次, 各会话发送缓冲引用共享不拷贝;
+			 * TLS会话需要逐个加密, 退化为拷贝。
+			 * @param fds 会话fd数组
+			 * @param numfds fd个数
+			 * @param pdata 应用层消息
+			 * @param size 消息长度
+			 * @return 成功提交发送的会话数
+			*/
+			int broadcast(const int* fds, int numfds, const void* pdata, size_t size)
+			{
+				bcframes frms(pdata, size);
+				psession pss;
+				int n = 0;
+				for (auto i = 0; i < numfds; i++) {
+					pss = nullptr;
+					if (!getsession_(fds[i], pss))
+						continue;
+					if (pss->sendasyn_bc(&frms, _plog) < 0)
+						continue;
+					chksndwater_(fds[i], pss);
+					if (postsend(fds[i]) < 0)
+						continue;
+					++n;
+				}
+				return n;
+			}
+
+			/**
+			 * @brief 零拷贝发送, 引用缓冲不拷贝到发送缓冲; linux下使用MSG_ZEROCOPY, 内核发送完成后才释放引用。
+			 * TLS和压缩的websocket会话需要编码, 会退化为拷贝发送。
+			 * @param fd
+			 * @param pbuf 引用缓冲, 内部会增加引用计数, 调用者仍需release自己的引用
+			 * @return 同sendtofd
+			*/
+			int sendtofd_zc(int fd, ec::refbuf* pbuf)
+			{
+				psession pss = nullptr;
+				if (!pbuf || !getsession_(fd, pss))
+					return -1;
+#ifndef _WIN32
+				if (!pss->_zcflag) {
+					pss->_zcflag = setzerocopy(fd) ? 1 : -1;
+					if (pss->_zcflag < 0)
+						_plog->add(CLOG_DEFAULT_DBG, "fd(%d) SO_ZEROCOPY not supported, error %d", fd, errno);
+				}
+#endif
+				if (pss->sendasyn_ref(pbuf, _plog) < 0)
+					return -1;
+				chksndwater_(fd, pss);
 				return postsend(fd);
 			}
 
+#ifndef _WIN32
+			/**
+			 * @brief 线程安全的发送投递, 可在任意线程调用, 数据在本服务的epoll线程中经sendtofd()发送。
+			 * @param fd
+			 * @param pdata
+			 * @param size
+			 * @return 0:已投递; -1:error
+			*/
+			int postsend_from_any_thread(int fd, const void* pdata, size_t size)
+			{
+				if (!pdata || !size)
+					return -1;
+				if (!_xmsgs.emplace(fd, pdata, size))
+					return -1;
+				if (!_xwake.exchange(true))
+					wakeup();
+				return 0;
+			}
+#endif
+
 			/**
 			 * @brief 异步连接, 会建立一个默认的tcp session, 连接成功后会使用onTcpConnectOut通知
 			 * @return 返回keyfd
@@ -255,37 +1035,47 @@ namespace ec {
 				}
 				setkeepalive(fd);
 #ifndef _WIN32
+				if (_busypollus)
+					_net.setbusypoll(fd, _busypollus);
 				if (epoll_add_tcpout(fd) < 0) {
 					delete pss;
 					return -1;
 				}
 #endif
-				_mapsession.set(fd, pss);
+				setsession_(fd, pss);
+				idletimer_(pss);
 				return fd;
 			}
 
 		protected:
 			/**
-			 * @brief 处理会话接收缓冲中可能分离出的消息，返回处理的消息数
+			 * @brief 处理就绪列表中会话接收缓冲中可能分离出的消息，返回处理的消息数
+			 * @remark 只访问消息处理数用完时加入就绪列表的会话, 本次仍用完的再加到列表尾部, 各会话轮流处理
 			 * @return 返回处理的消息数; 
 			*/
 			int doRecvBuffer()
 			{
-				int msgtype, n = 0, nfd, nup;
+				if (_readyfds.empty())
+					return 0;
+				int msgtype, n = 0, nup;
 				ec::bytes msg;
 				ec::vector<int> dels;
-				dels.reserve(32);
+				_readyrun.clear();
+				_readyrun.swap(_readyfds);
 
 				ec::aio::psession pss = nullptr;
-				uint64_t pos = _mapsession._begin(), posp = pos;
-				while (_mapsession.next(pos, pss)) {
+				for (const auto& nfd : _readyrun) {
+					if (!getsession_(nfd, pss))
+						continue;
+					pss->_rdready = 0;
 					if (pss->_time_error) {
-						posp = pos;
+						delaytimer_(pss);
 						continue;
 					}
 					nup = pss->msglevel();
-					nfd = pss->_fd;
 					do {
+						if (_rlon && !rlmsgok_(pss))
+							break;
 						msgtype = pss->onrecvbytes(nullptr, 0, _plog, &msg);
 						if (EC_AIO_MSG_NUL == msgtype) {
 							break;
@@ -296,6 +1086,7 @@ namespace ec {
 							break;
 						}
 						else if (EC_AIO_MSG_ERR == msgtype) {
+							++_mtparseerr;
 							dels.push_back(nfd);
 							_plog->add(CLOG_DEFAULT_DBG, "fd(%d) parse message failed in doRecvBuffer.", nfd);
 							break;
@@ -304,20 +1095,23 @@ namespace ec {
 							++n;
 							_plog->add(CLOG_DEFAULT_ALL, "fd(%d) %s parse one recvbuf msgtype = %d success",
 								pss->_fd, pss->ProtocolName(pss->_protocol), msgtype);
-							if (domessage(nfd, msg, msgtype) < 0) {
-								if (!_mapsession.has(nfd)) { //delete the nfd in domessage or postsend
-									pos = posp;
+							++_mtmsgs;
+							if (_rlon)
+								rlconsume_(pss, 0, 1, 0);
+							if (domessage_(pss, msg, msgtype) < 0) {
+								if (!getsession_(nfd, pss)) //delete the nfd in domessage or postsend
 									_plog->add(CLOG_DEFAULT_ALL, "fd(%d) disconnected at doRecvBuffer", nfd);
-								}
 								else
 									dels.push_back(nfd);
 								break;
 							}
 							msg.clear();
-							--nup;
+							if (!getsession_(nfd, pss))
+								break;
+							if (--nup <= 0) // 处理数用完,可能还有消息
+								setready_(pss);
 						}
 					} while (nup > 0);
-					posp = pos;
 				}
 				for (const auto& fd : dels) {
 					if (0 == closefd(fd, 0)) //主动断开
@@ -326,6 +1120,75 @@ namespace ec {
 				return n;
 			}
 
+#ifndef _WIN32
+			void tcptune_(int fd, psession pss, const t_tcptune& tune) // 设置接入连接的TCP选项
+			{
+				if (tune._nodelay)
+					_net.tcpnodelay(fd);
+				if (tune._quickack)
+					_net.settcpopt(fd, TCP_QUICKACK, 1);
+				if (tune._notsentlowat > 0 && _net.settcpopt(fd, TCP_NOTSENT_LOWAT, tune._notsentlowat) < 0)
+					_plog->add(CLOG_DEFAULT_DBG, "fd(%d) set TCP_NOTSENT_LOWAT failed, error %d", fd, errno);
+				pss->_tcpcork = tune._cork ? 1 : 0;
+			}
+#endif
+
+#ifndef _WIN32
+			/**
+			 * @brief 热重启导入非TCP协议的会话时重建会话对象, 应用层自定义的会话类需重载
+			 * @param pss onAccept创建的基本会话
+			 * @param protocol 旧进程中的协议
+			 * @return 重建的会话, 已替换会话表中的pss; nullptr:不支持
+			*/
+			virtual psession onImportSession(psession pss, int protocol)
+			{
+#if (0 != EC_AIOSRV_HTTP)
+				if (EC_AIO_PROC_HTTP == protocol || EC_AIO_PROC_WS == protocol) {
+					psession phttp = new session_http(std::move(*pss));
+					setsession_(phttp->_fd, phttp);
+					return phttp;
+				}
+#endif
+#if (0 != EC_AIOSRV_TLS)
+				if (EC_AIO_PROC_TLS == protocol || EC_AIO_PROC_HTTPS == protocol || EC_AIO_PROC_WSS == protocol)
+					return nullptr;
+#endif
+				return pss;
+			}
+#endif
+
+			/**
+			 * @brief 调用domessage, EC_AIO_PROFILE时统计耗时
+			*/
+			inline int domessage_(psession pss, ec::bytes& msg, int msgtype)
+			{
+#if EC_AIO_PROFILE
+				int fd = pss->_fd, protocol = pss->_protocol; // domessage中pss可能被删除
+				const char* sproto = pss->ProtocolName(pss->_protocol);
+				size_t zmsg = msg.size();
+				int64_t ust = ec::ustime_mono();
+				int nr = domessage(fd, msg, msgtype);
+				ust = ec::ustime_mono() - ust;
+				_prof._msg.add(ust);
+				if (_prof.slow(ust))
+					_plog->add(CLOG_DEFAULT_WRN, "slow domessage fd(%d) protocol %d(%s) msgtype %d size %zu %lld us", fd, protocol, sproto, msgtype, zmsg, (long long)ust);
+				return nr;
+#else
+				return domessage(pss->_fd, msg, msgtype);
+#endif
+			}
+
+			/**
+			 * @brief 加入doRecvBuffer就绪列表
+			*/
+			inline void setready_(psession pss)
+			{
+				if (pss->_rdready)
+					return;
+				pss->_rdready = 1;
+				_readyfds.push_back(pss->_fd);
+			}
+
 			/**
 			 * @brief size can receive ,use for flowctrl
 			 * @param pss
@@ -333,11 +1196,145 @@ namespace ec {
 			*/
 			virtual size_t  sizeCanRecv(psession pss) {
 				
+				if (_sndwaterrd && pss->_sndpaused)
+					return 0;
 				if (!pss->_lastappmsg || pss->_rbuf.empty())
-					return EC_AIO_READONCE_SIZE;
+					return _rlon ? rlcanrecv_(pss) : EC_AIO_READONCE_SIZE;
 				return 0;
 			};
 
+			/**
+			 * @brief 可发送字节数, 发送限速令牌不足时启动恢复定时器并返回0
+			*/
+			virtual size_t sizeCanSend(psession pss)
+			{
+				if (!_rlon)
+					return SIZE_MAX;
+				int64_t ust = ec::ustime_mono(), z = INT64_MAX, n, ms = 0;
+				t_ratelimit* pl[3];
+				rllimits_(pss, pl);
+				for (auto p : pl) {
+					if (!p)
+						continue;
+					if ((n = p->_snd.avail(ust)) <= 0 && p->_snd.mswait() > ms)
+						ms = p->_snd.mswait();
+					if (n < z)
+						z = n;
+				}
+				if (z > 0)
+					return (size_t)z;
+				ratetimer_(pss, ms);
+				return 0;
+			}
+
+			void rllimits_(psession pss, t_ratelimit* pl[3]) // 会话, 监听端口合计, 全局
+			{
+				t_listenlimit_* pll = pss->_fdlisten >= 0 ? listenlimit_(pss->_fdlisten) : nullptr;
+				pl[0] = &pss->_ratelimit;
+				pl[1] = pll ? &pll->_all : nullptr;
+				pl[2] = &_rlglobal;
+			}
+
+			t_listenlimit_* listenlimit_(int fdlisten)
+			{
+				for (auto& i : _rllisten) {
+					if (i._fdlisten == fdlisten)
+						return &i;
+				}
+				return nullptr;
+			}
+
+			size_t rlcanrecv_(psession pss) // 接收限速, 令牌不足时启动恢复定时器并返回0
+			{
+				int64_t ust = ec::ustime_mono(), z = EC_AIO_READONCE_SIZE, n, ms = 0;
+				t_ratelimit* pl[3];
+				rllimits_(pss, pl);
+				for (auto p : pl) {
+					if (!p)
+						continue;
+					if ((n = p->_rcv.avail(ust)) <= 0 && p->_rcv.mswait() > ms)
+						ms = p->_rcv.mswait();
+					if (n < z)
+						z = n;
+					if (p->_msg.avail(ust) <= 0) {
+						z = 0;
+						if (p->_msg.mswait() > ms)
+							ms = p->_msg.mswait();
+					}
+				}
+				if (z > 0)
+					return (size_t)z;
+				ratetimer_(pss, ms);
+				return 0;
+			}
+
+			bool rlmsgok_(psession pss) // 还有接收消息令牌, 没有时启动恢复定时器
+			{
+				int64_t ust = ec::ustime_mono(), ms = 0;
+				t_ratelimit* pl[3];
+				rllimits_(pss, pl);
+				for (auto p : pl) {
+					if (p && p->_msg.avail(ust) <= 0 && p->_msg.mswait() > ms)
+						ms = p->_msg.mswait();
+				}
+				if (!ms)
+					return true;
+				ratetimer_(pss, ms);
+				return false;
+			}
+
+			void rlconsume_(psession pss, int64_t rcvbytes, int64_t rcvmsgs, int64_t sndbytes)
+			{
+				t_ratelimit* pl[3];
+				rllimits_(pss, pl);
+				for (auto p : pl) {
+					if (!p)
+						continue;
+					p->_rcv.consume(rcvbytes);
+					p->_msg.consume(rcvmsgs);
+					p->_snd.consume(sndbytes);
+				}
+			}
+
+			/**
+			 * @brief 发送缓冲到达高水位, 应用层生产者应暂停向该连接发送
+			 * @param fd
+			 * @param sndbufsize 当前发送缓冲字节数
+			*/
+			virtual void onSendHighWater(int fd, size_t sndbufsize) {};
+
+			/**
+			 * @brief 发送缓冲从高水位降到低水位, 应用层生产者可以恢复发送
+			*/
+			virtual void onSendLowWater(int fd, size_t sndbufsize) {};
+
+			/**
+			 * @brief 发送后缓冲大小变化, 检查低水位. 派生类重载时需调用此基类函数
+			*/
+			virtual void onSendBufSizeChanged(int kfd, size_t sendbufsize, int protocol) override
+			{
+				psession pss = nullptr;
+				if (getsession_(kfd, pss))
+					chksndwater_(kfd, pss);
+			}
+
+			void chksndwater_(int fd, psession pss)
+			{
+				size_t zs = pss->_sndbuf.size();
+				if (!pss->_sndpaused) {
+					if (pss->_sndhigh && zs >= pss->_sndhigh) {
+						pss->_sndpaused = 1;
+						_plog->add(CLOG_DEFAULT_DBG, "fd(%d) send buffer %zu bytes reach high water.", fd, zs);
+						onSendHighWater(fd, zs);
+					}
+				}
+				else if (!pss->_sndhigh || zs <= pss->_sndlow) {
+					pss->_sndpaused = 0;
+					_plog->add(CLOG_DEFAULT_DBG, "fd(%d) send buffer %zu bytes fall to low water.", fd, zs);
+					onSendLowWater(fd, zs);
+				}
+			}
+
 			/**
 			 * @brief 是否容许协议接入
 			 * @param fdlisten 监听端口
@@ -368,11 +1365,146 @@ namespace ec {
 			{
 			}
 
+			template<class _STR>
+			void promline_(_STR& sout, const char* name, const char* label, const char* labelval, int64_t v)
+			{
+				sout.append(name);
+				if (label) {
+					sout.push_back('{');
+					sout.append(label).append("=\"").append(labelval).append("\"}");
+				}
+				sout.push_back(' ');
+				ec::js::number_outstring(v, sout);
+				sout.push_back('\n');
+			}
+
+			template<class _STR>
+			void promtype_(_STR& sout, const char* name, const char* stype)
+			{
+				sout.append("# TYPE ").append(name).push_back(' ');
+				sout.append(stype).push_back('\n');
+			}
+
+			template<class _STR>
+			void promvalue_(_STR& sout, const char* name, const char* stype, int64_t v)
+			{
+				promtype_(sout, name, stype);
+				promline_(sout, name, nullptr, nullptr, v);
+			}
+
+			template<class _STR>
+			void promhist_(_STR& sout, const char* name, const t_lathist& h) // 按Prometheus summary输出
+			{
+				char sn[80];
+				promtype_(sout, name, "summary");
+				snprintf(sn, sizeof(sn), "%s{quantile=\"0.5\"}", name);
+				promline_(sout, sn, nullptr, nullptr, h.percentile(50));
+				snprintf(sn, sizeof(sn), "%s{quantile=\"0.99\"}", name);
+				promline_(sout, sn, nullptr, nullptr, h.percentile(99));
+				snprintf(sn, sizeof(sn), "%s{quantile=\"1\"}", name);
+				promline_(sout, sn, nullptr, nullptr, h._max);
+				snprintf(sn, sizeof(sn), "%s_sum", name);
+				promline_(sout, sn, nullptr, nullptr, h._sum);
+				snprintf(sn, sizeof(sn), "%s_count", name);
+				promline_(sout, sn, nullptr, nullptr, (int64_t)h._count);
+			}
+
+			template<class _STR>
+			void jsonhist_(_STR& sout, const char* key, const t_lathist& h)
+			{
+				int nf = 0;
+				sout.append(",\"").append(key).append("\":{");
+				ec::js::out_jnumber(nf, "count", h._count, sout, true);
+				ec::js::out_jnumber(nf, "mean", h.mean(), sout, true);
+				ec::js::out_jnumber(nf, "p50", h.percentile(50), sout, true);
+				ec::js::out_jnumber(nf, "p99", h.percentile(99), sout, true);
+				ec::js::out_jnumber(nf, "max", h._max, sout, true);
+				sout.push_back('}');
+			}
+
+			enum timertype_ {
+				tm_user = 0, // settimer()
+				tm_delay, // 延迟断开
+				tm_idle, // 空闲超时
+				tm_rate // 限速令牌补充后恢复读写
+			};
+
+			void ratetimer_(psession pss, int64_t msdelay) // 启动限速恢复定时器
+			{
+				if (pss->_tmrate)
+					return;
+				int id = _timers.add(pss->_fd, tm_rate, msdelay);
+				pss->_tmrate = id > 0 ? id : 0;
+			}
+
+			void delaytimer_(psession pss) // _time_error已设置时启动延迟断开定时器, 已有的定时器取消后重新设置
+			{
+				if (!pss->_time_error)
+					return;
+				if (pss->_tmdelay) {
+					_timers.cancel(pss->_tmdelay);
+					pss->_tmdelay = 0;
+				}
+				int64_t sec = pss->_time_error + 5 - ::time(nullptr);
+				int id = _timers.add(pss->_fd, tm_delay, sec > 0 ? sec * 1000 : 0);
+				pss->_tmdelay = id > 0 ? id : 0;
+			}
+
+			void idletimer_(psession pss) // 启动空闲超时定时器
+			{
+				if (!_idlesec || pss->_tmidle)
+					return;
+				int64_t sec = pss->_time_active + _idlesec - ::time(nullptr);
+				int id = _timers.add(pss->_fd, tm_idle, sec > 0 ? sec * 1000 : 0);
+				pss->_tmidle = id > 0 ? id : 0;
+			}
+
+			void ontimer_(int id, int fd, int type, ec::timerwheel::callback& cb)
+			{
+				psession pss = nullptr;
+				if (fd >= 0 && !getsession_(fd, pss))
+					return;
+				if (tm_user == type) {
+					cb(fd, id);
+					return;
+				}
+				if (tm_rate == type) {
+					pss->_tmrate = 0;
+					if (!pss->_rbuf.empty())
+						setready_(pss);
+					sendtrigger(fd); //重新评估读写事件
+					return;
+				}
+				time_t curt = ::time(nullptr);
+				if (tm_delay == type) {
+					pss->_tmdelay = 0;
+					if (!pss->_time_error)
+						return;
+					if (curt - pss->_time_error < 5) { // 延迟断开时间被修改过
+						delaytimer_(pss);
+						return;
+					}
+					_plog->add(CLOG_DEFAULT_INF, "close fd(%d) delayed disconnect.", fd);
+					closefd(fd, 0); //主动断开
+				}
+				else if (tm_idle == type) {
+					pss->_tmidle = 0;
+					if (!_idlesec)
+						return;
+					if (curt - pss->_time_active < _idlesec) {
+						idletimer_(pss);
+						return;
+					}
+					_plog->add(CLOG_DEFAULT_INF, "close fd(%d) idle timeout %d seconds.", fd, _idlesec);
+					closefd(fd, 0);
+				}
+			}
+
 			void onCloseFd(int kfd) override
 			{
 				if (getsessionstatus(kfd) >= EC_AIO_FD_CONNECTED) {
 					psession pss = nullptr;
-					if (_mapsession.get(kfd, pss)) {
+					if (getsession_(kfd, pss)) {
 						if (pss && (EC_AIO_PROC_WS == pss->_protocol || EC_AIO_PROC_WSS == pss->_protocol)) {
 							if (pss->onClose(1000, nullptr, 0)) {//发送正常断开握手信息
 								postsend(kfd, 10);
@@ -397,6 +1529,15 @@ namespace ec {
 			virtual void onDisconnected(int fd)
 			{
 				_plog->add(CLOG_DEFAULT_DBG, "netserver::onDisconnected fd(%d)", fd);
+				psession pss = nullptr;
+				if (getsession_(fd, pss) && pss) { // 取消会话的定时器, 否则节点要到期后才回收
+					if (pss->_tmidle)
+						_timers.cancel(pss->_tmidle);
+					if (pss->_tmdelay)
+						_timers.cancel(pss->_tmdelay);
+					if (pss->_tmrate)
+						_timers.cancel(pss->_tmrate);
+				}
 				_mapsession.erase(fd);//从协议层清空
 			}
 			
@@ -438,7 +1579,7 @@ namespace ec {
 					psession ptls = new session_tls(fd, std::move(**pi), pCA, _plog);
 					if (!ptls)
 						return -1;
-					_mapsession.set(ptls->_fd, ptls);
+					setsession_(ptls->_fd, ptls);
 					*pi = ptls;
 					if (_plog)
 						_plog->add(CLOG_DEFAULT_MSG, "fd(%d) update TLS1.2 protocol success", fd);
@@ -459,7 +1600,7 @@ namespace ec {
 					psession phttp = new session_http(std::move(**pi));
 					if (!phttp)
 						return -1;
-					_mapsession.set(phttp->_fd, phttp);
+					setsession_(phttp->_fd, phttp);
 					*pi = phttp;
 					if (_plog)
 						_plog->add(CLOG_DEFAULT_MSG, "fd(%u) update HTTP protocol success", fd);
@@ -496,7 +1637,7 @@ namespace ec {
 					psession phttp = new session_https(std::move(*((session_tls*)*pi)));
 					if (!phttp)
 						return -1;
-					_mapsession.set(phttp->_fd, phttp);
+					setsession_(phttp->_fd, phttp);
 					*pi = phttp;
 					if (_plog)
 						_plog->add(CLOG_DEFAULT_MSG, "fd(%u) update HTTPS protocol success", fd);
@@ -512,7 +1653,7 @@ namespace ec {
 			/**
 			 * @brief 接收数据
 			 * @param kfd   keyfd
-			 * @param pdata Received data
+			 * @param pdata Received data, nullptr表示已直接读入会话的_rbuf
 			 * @param size  Received data size
 			 * @return 0:OK; -1:error，will be close 
 			*/
@@ -523,20 +1664,36 @@ namespace ec {
 				_bpsRcv.add(mscurtime, (int64_t)size);
 
 				psession pss = nullptr;
-				if (!_mapsession.get(kfd, pss))
+				if (!getsession_(kfd, pss))
 					return -1;
+				pss->_time_active = ::time(nullptr);
 				if (pss->_time_error) {
+					if (!pdata)
+						pss->_rbuf.free();
+					delaytimer_(pss);
 					return EC_AIO_MSG_NUL;
 				}
 				pss->_allrecv += size;
 				pss->_bpsRcv.add(mscurtime, (int64_t)size);
+#if EC_AIO_PROFILE
+				pss->_usrecv = ec::ustime_mono();
+#endif
+				if (_rlon)
+					rlconsume_(pss, (int64_t)size, 0, 0);
 				ec::bytes msg;
-				int msgtype = pss->onrecvbytes(pdata, size, _plog, &msg);
+				int msgtype;
+				if (pdata)
+					msgtype = pss->onrecvbytes(pdata, size, _plog, &msg);
+				else // 已在_rbuf中
+					msgtype = EC_AIO_PROC_TCP == pss->_protocol ? EC_AIO_MSG_TCP : pss->onrecvbytes(nullptr, 0, _plog, &msg);
 				if (EC_AIO_PROC_TCP == pss->_protocol && EC_AIO_MSG_TCP == msgtype) {
-					pss->_rbuf.append(msg.data(), msg.size());
+					if (pdata)
+						pss->_rbuf.append(msg.data(), msg.size());
 					int nup = onupdate_proctcp(pss->_fd, &pss);
-					if (nup != 1)
+					if (nup != 1) {
+						delaytimer_(pss);
 						return nup;
+					}
 					msg.clear();
 					msgtype = pss->onrecvbytes(nullptr, 0, _plog, &msg);
 				}
@@ -544,8 +1701,10 @@ namespace ec {
 				else if (EC_AIO_PROC_TLS == pss->_protocol && EC_AIO_MSG_TCP == msgtype) {
 					pss->_rbuf.append(msg.data(), msg.size());
 					int nup = onupdate_proctls(pss->_fd, &pss);
-					if (nup != 1)
+					if (nup != 1) {
+						delaytimer_(pss);
 						return nup;
+					}
 					msg.clear();
 					msgtype = pss->onrecvbytes(nullptr, 0, _plog, &msg);
 				}
@@ -554,16 +1713,25 @@ namespace ec {
 					int ndo = pss->msglevel(); //处理ndo个消息,剩下得在doRecvBuffer中处理。
 					do {
 						--ndo;
-						if (domessage(pss->_fd, msg, msgtype) < 0) {
+						++_mtmsgs;
+						if (_rlon)
+							rlconsume_(pss, 0, 1, 0);
+						if (domessage_(pss, msg, msgtype) < 0) {
 							_plog->add(CLOG_DEFAULT_WRN, "fd(%d) domessage message failed.", pss->_fd);
 							return -1;
 						}
 						msg.clear();
-						if(ndo > 0)
+						if (ndo > 0) {
+							if (_rlon && (!getsession_(kfd, pss) || !rlmsgok_(pss)))
+								break; // 消息令牌用完,剩下的在定时器恢复后处理
 							msgtype = pss->onrecvbytes(nullptr, 0, _plog, &msg);
+						}
 					} while (ndo > 0 && msgtype > EC_AIO_MSG_NUL);
+					if (msgtype > EC_AIO_MSG_NUL && getsession_(kfd, pss)) // 处理数用完,剩下的在doRecvBuffer中处理
+						setready_(pss);
 				}
 				if (msgtype == EC_AIO_MSG_ERR) {
+					++_mtparseerr;
 					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) read error message.", pss->_fd);
 					return -1;
 				}
@@ -582,7 +1750,7 @@ namespace ec {
 			virtual psession getSession(int kfd)
 			{
 				psession ps = nullptr;
-				if (!_mapsession.get(kfd, ps)) {
+				if (!getsession_(kfd, ps)) {
 					return nullptr;
 				}
 				return ps;
@@ -591,19 +1759,73 @@ namespace ec {
 			virtual void onAccept(int fd, const char* sip, uint16_t port, int fdlisten)
 			{
 				setkeepalive(fd);
+#ifndef _WIN32
+				if (_busypollus && _net.setbusypoll(fd, _busypollus) < 0)
+					_plog->add(CLOG_DEFAULT_DBG, "fd(%d) set SO_BUSY_POLL failed, error %d", fd, errno);
+#endif
 				psession pss = new session(&_sndbufblks, fd, fdlisten);
 				if (!pss)
 					return;
+				++_mtaccepts;
+				_bpsAccept.add(ec::mstime(), 1);
 				pss->_status = EC_AIO_FD_CONNECTED;
 				ec::strlcpy(pss->_peerip, sip, sizeof(pss->_peerip));
 				pss->_peerport = port;
-				_mapsession.set(fd, pss);
+				if (_rlon) {
+					t_listenlimit_* pl = listenlimit_(fdlisten);
+					if (pl)
+						pss->_ratelimit = pl->_persession;
+				}
+#ifndef _WIN32
+				for (auto& i : _tunelisten) {
+					if (i._fdlisten == fdlisten) {
+						tcptune_(fd, pss, i._tune);
+						break;
+					}
+				}
+#endif
+				setsession_(fd, pss);
+				idletimer_(pss);
 			}
 
+#ifndef _WIN32
+			virtual void onWakeup()
+			{
+				_xwake.exchange(false); // 先清标志再取, 之后入队的会再次唤醒; 用exchange而不是store, 防止与后面pop的读重排丢失唤醒
+				t_xmsg m;
+				int n = 0;
+				int64_t ust = ec::ustime_mono();
+				while (n < EC_AIO_XMSG_BATCH && _xmsgs.pop(m)) {
+					++n;
+					_latency.add(ust - m._ustime);
+					if (sendtofd(m._fd, m._data.data(), m._data.size()) < 0)
+						_plog->add(CLOG_DEFAULT_DBG, "fd(%d) postsend_from_any_thread failed.", m._fd);
+				}
+				if (n >= EC_AIO_XMSG_BATCH && !_xwake.exchange(true)) // 还有未取完的, 下一轮继续
+					wakeup();
+			}
+#endif
 			virtual void onSendCompleted(int kfd, size_t size)
 			{
 				_allsend += size;
 				_bpsSnd.add(ec::mstime(), (int64_t)size);
+				psession pss = nullptr;
+				if (!getsession_(kfd, pss))
+					return;
+#if EC_AIO_PROFILE
+				if (pss->_usrecv) {
+					_prof._turn.add(ec::ustime_mono() - pss->_usrecv);
+					pss->_usrecv = 0;
+				}
+#endif
+				if (_rlon)
+					rlconsume_(pss, 0, 0, (int64_t)size);
+#ifndef _WIN32
+				if (pss->_tcpcork > 1 && pss->_sndbuf.empty() && !pss->hasSendJob()) { // 多段发送完成, 取消TCP_CORK发出剩余数据
+					pss->_tcpcork = 1;
+					_net.settcpopt(kfd, TCP_CORK, 0);
+				}
+#endif
 			}
 
 			virtual int onReceivedFrom(int kfd, const void* pdata, size_t size, const struct sockaddr* addrfrom, int addrlen) {				
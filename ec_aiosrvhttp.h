@@ -6,6 +6,7 @@ http/ws server
 \author  jiangyong
 
 \update 
+  2026-10-16 大文件下载在监听端口配置了TCP_CORK时使用tcpcork()
   2024-2-1   use ec::string::appendformat instead of ec::array<char>
   2023-12-25 fix http Security vulnerability
   2023-5-30 support multi http root path
@@ -246,6 +247,8 @@ namespace ec {
 				if (!ps)
 					return false;
 				ps->setHttpDownFile(sfile, HTTP_RANGE_SIZE, filelen);
+				if (1 == ps->_tcpcork) // 头和文件块满包发送, 发完后取消
+					tcpcork(fd);
 				return sendtofd(fd, data.data(), data.size()) >= 0;
 			}
 			bool DoGetRang(int fd, const char* sfile, ec::http::package* pPkg, int64_t lpos, int64_t lposend, int64_t lfilesize)
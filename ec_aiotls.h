@@ -4,6 +4,9 @@
 Asynchronous TLS1.2 session
 
 \author  jiangyong
+\update
+  2026-10-16 TLS会话状态不能交接, exportstate()返回false
+  2026-10-16 sendasyn_ref() 加密后发送,不能引用原数据
 
 eclib 4.0 Copyright (c) 2017-2024, kipway
 source repository : https://github.com/kipway
@@ -80,6 +83,13 @@ namespace ec {
 				return -1;
 			}
 
+			virtual int sendasyn_ref(ec::refbuf* pbuf, ec::ilog* plog)
+			{
+				return sendasyn(pbuf->data(), pbuf->size(), plog);
+			}
+
+			virtual bool exportstate(ec::string& so) { return false; }
+
 		protected:
 			ec::tls::sessionserver _tls;
 		};
@@ -3,6 +3,15 @@
 \author	jiangyong
 \email  kipway@outlook.com
 \update
+  2026.10.16 blk_alloctor注释删除耗时数据, 只保留用法
+  2026.10.16 线程缓存EC_ALLOCTOR_TCACHE默认不使用; free_()中不属于本分配器的块(classidx为-1)不使用线程缓存和统计
+  2026.10.16 分配统计改为取得内存块后才计数, 分配失败不计入
+  2026.10.16 大页模式下按大页整数倍调整每堆块数, 取整浪费超过1/EC_ALLOCTOR_HUGEPAGE_WASTE时使用普通页
+  2026.10.16 增加分配统计EC_ALLOCTOR_PROFILE, 按块大小统计分配,释放,峰值,加锁耗时和大内存, 按间隔采样调用栈, profilejs()输出JSON
+  2026.10.16 blk_sysmalloc支持大页EC_ALLOCTOR_HUGEPAGE和按线程NUMA节点分配EC_ALLOCTOR_NUMA(linux)
+  2026.10.16 allocator::malloc_查表定位块大小, 代替二分查找
+  2026.10.16 blk_alloctor增加有空闲块的堆链表, 分配,释放和回收空闲堆都为O(1)
+  2026.10.16 增加小内存线程缓存EC_ALLOCTOR_TCACHE, 批量从blk_alloctor补充和归还
   2025.3.24 再次优化小内存
   2025.3.7  小内存使用优化
   2024.12.02 update memory block initialization
@@ -22,6 +31,7 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #pragma once
 #include <cassert>
 #include <atomic>
+#include <cstdint>
 #include <string.h>
 
 #define _ZLIB_SELF_ALLOC
@@ -78,6 +88,57 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 
 #define EC_ALLOCTOR_LARGEMEM_HEADSIZE (2 * EC_ALLOCTOR_ALIGN) // head size of large memory
 
+#ifndef EC_ALLOCTOR_HUGEPAGE // 大于等于EC_ALLOCTOR_HUGEPAGE_MINSIZE的系统内存使用大页(linux). 0:不使用; 1:透明大页; 2:显式大页MAP_HUGETLB,失败时使用透明大页
+#define EC_ALLOCTOR_HUGEPAGE 0
+#endif
+
+#ifndef EC_ALLOCTOR_HUGEPAGE_MINSIZE // 2M/4M的堆和io_buffer的发送缓冲堆
+#define EC_ALLOCTOR_HUGEPAGE_MINSIZE (2 * 1024 * 1024)
+#endif
+
+#define EC_ALLOCTOR_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+#ifndef EC_ALLOCTOR_HUGEPAGE_WASTE // 按大页取整多出的内存超过1/EC_ALLOCTOR_HUGEPAGE_WASTE时使用普通页
+#define EC_ALLOCTOR_HUGEPAGE_WASTE 8
+#endif
+
+#ifndef EC_ALLOCTOR_NUMA // 1:系统内存优先分配在blk_numa_setnode()设置的当前线程NUMA节点(linux)
+#define EC_ALLOCTOR_NUMA 0
+#endif
+
+#ifndef EC_ALLOCTOR_PROFILE // 1:分配统计, 用于调整EC_ALLOCTOR_*HEAP_SIZE, 有性能损失
+#define EC_ALLOCTOR_PROFILE 0
+#endif
+
+#ifndef EC_ALLOCTOR_PROFILE_SAMPLE // 每分配多少次采样一次调用栈, 0:不采样
+#define EC_ALLOCTOR_PROFILE_SAMPLE 4096
+#endif
+
+#ifndef EC_ALLOCTOR_PROFILE_SAMPLES // 保留最近的采样数
+#define EC_ALLOCTOR_PROFILE_SAMPLES 256
+#endif
+
+#define EC_ALLOCTOR_PROFILE_FRAMES 8 // 每个采样的返回地址数
+
+#ifndef EC_ALLOCTOR_LUT_SMLSIZE // 小于等于此大小按8字节一项直接查表, 更大的按2的幂分段查表
+#define EC_ALLOCTOR_LUT_SMLSIZE 2048
+#endif
+
+#ifndef EC_ALLOCTOR_TCACHE // 1:小内存块使用线程缓存, 减少spinlock竞争; 缓存的块不立即归还堆, 默认不使用
+#define EC_ALLOCTOR_TCACHE 0
+#endif
+
+#ifndef EC_ALLOCTOR_TCACHE_MAXSIZE // 使用线程缓存的最大块
+#define EC_ALLOCTOR_TCACHE_MAXSIZE 2048
+#endif
+
+#ifndef EC_ALLOCTOR_TCACHE_BYTES // 每个线程每种块缓存的最大字节数
+#define EC_ALLOCTOR_TCACHE_BYTES (16 * 1024)
+#endif
+
+#define EC_ALLOCTOR_TCACHE_CLASSES 16 // 最多缓存的块种类
+#define EC_ALLOCTOR_TCACHE_BLKS 64 // 每种块最多缓存的块数
+
 #ifndef EC_ALLOCTOR_FIRSTHEAP_SIZE
 #define EC_ALLOCTOR_FIRSTHEAP_SIZE (1024 * 32)
 #endif
@@ -85,6 +146,10 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #define EC_ALLOCTOR_FIRSTHEAP_BLKS 16
 #endif
 
+#if EC_ALLOCTOR_PROFILE
+#include <chrono>
+#endif
+
 #ifdef _WIN32
 #include <memoryapi.h>
 namespace ec {
@@ -109,9 +174,20 @@ namespace ec {
 	}
 }
 #else
+#include <unistd.h>
 #include <sys/mman.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
 #include <malloc.h>
+#if EC_ALLOCTOR_PROFILE
+#include <execinfo.h>
+#endif
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
 namespace ec {
 	struct glibc_noarena {
 		glibc_noarena() {
@@ -120,15 +196,92 @@ namespace ec {
 			mallopt(M_TRIM_THRESHOLD, EC_ALLOCTOR_SHEAP_SIZE);
 		}
 	};
+	inline int& blk_numanode_() {
+		static thread_local int node = -1;
+		return node;
+	}
+
+	/**
+	 * @brief 设置当前线程分配系统内存的NUMA节点, 需EC_ALLOCTOR_NUMA
+	 * @param node 节点号; -1:不指定,使用系统默认策略
+	 */
+	inline void blk_numa_setnode(int node) {
+		blk_numanode_() = node;
+	}
+
+	inline int blk_numa_getnode() {
+		return blk_numanode_();
+	}
+
+	/**
+	 * @brief 当前线程所在CPU的NUMA节点
+	 * @return 节点号; -1:失败
+	 */
+	inline int blk_numa_curnode() {
+		unsigned int cpu = 0, node = 0;
+		if (syscall(SYS_getcpu, &cpu, &node, nullptr) < 0)
+			return -1;
+		return (int)node;
+	}
+
+	inline void blk_sysbind_(void* ptr, size_t size) {
+#if EC_ALLOCTOR_NUMA
+		int node = blk_numanode_();
+		if (node < 0 || node >= (int)(sizeof(unsigned long) * 8))
+			return;
+		unsigned long mask = 1ul << node;
+		syscall(SYS_mbind, ptr, size, 1/*MPOL_PREFERRED*/, &mask, sizeof(mask) * 8, 0);
+#endif
+	}
+
 	inline void* blk_sysmalloc(size_t size, size_t* psize) {
+		void* ptr;
+#if EC_ALLOCTOR_HUGEPAGE
+		const size_t zh = EC_ALLOCTOR_HUGEPAGE_SIZE;
+		size_t zr = size % zh ? size + zh - size % zh : size;
+		if (zr >= EC_ALLOCTOR_HUGEPAGE_MINSIZE && (zr - size) * EC_ALLOCTOR_HUGEPAGE_WASTE <= zr) {
+			size = zr;
+#if EC_ALLOCTOR_HUGEPAGE > 1
+			ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+			if (MAP_FAILED != ptr) {
+				blk_sysbind_(ptr, size);
+				if (psize) {
+					*psize = size;
+				}
+				return ptr;
+			}
+#endif
+			char* pmem = (char*)mmap(nullptr, size + zh, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+			if (MAP_FAILED == (void*)pmem)
+				return nullptr;
+			size_t zhead = (zh - (size_t)((uintptr_t)pmem % zh)) % zh; // 按大页对齐, 裁掉首尾
+			if (zhead) {
+				munmap(pmem, zhead);
+			}
+			if (zh - zhead) {
+				munmap(pmem + zhead + size, zh - zhead);
+			}
+			pmem += zhead;
+			madvise(pmem, size, MADV_HUGEPAGE);
+			blk_sysbind_(pmem, size);
+			if (psize) {
+				*psize = size;
+			}
+			return pmem;
+		}
+#endif
 		size_t zp = sysconf(_SC_PAGE_SIZE);
 		if (size % zp) {
 			size += zp - (size % zp);
 		}
+		ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (MAP_FAILED == ptr)
+			return nullptr;
+		blk_sysbind_(ptr, size);
 		if (psize) {
 			*psize = size;
 		}
-		return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		return ptr;
 	}
 	inline bool blk_sysfree(void* ptr, size_t size) {
 		return !munmap(ptr, size);
@@ -365,6 +518,9 @@ namespace ec{
 		void* _palloc; //blk_alloctor for release optimization
 	public:
 		memheap_* _pnext; //point to next heap
+		memheap_* _pprev; //point to prior heap
+		memheap_* _pfnext; //next heap with free blocks
+		memheap_* _pfprev; //prior heap with free blocks
 		inline size_t numfree() const {
 			return _numfree;
 		}
@@ -392,7 +548,7 @@ namespace ec{
 		static void operator delete(void* ptr, void* voidptr2) noexcept {}
 	public:
 		memheap_(void* palloc) :_numfree(0), _numblk(0), _sizeblk(0), _posnext(0), _sizesystem(0), _pmem(nullptr),
-			_phead(nullptr), _palloc(palloc), _pnext(nullptr) {
+			_phead(nullptr), _palloc(palloc), _pnext(nullptr), _pprev(nullptr), _pfnext(nullptr), _pfprev(nullptr) {
 		}
 		~memheap_() {
 			if (_pmem) {
@@ -406,6 +562,9 @@ namespace ec{
 				_phead = nullptr;
 				_palloc = nullptr;
 				_pnext = nullptr;
+				_pprev = nullptr;
+				_pfnext = nullptr;
+				_pfprev = nullptr;
 			}
 		}
 		bool init(size_t sizeblk, size_t numblk) {
@@ -450,17 +609,52 @@ namespace ec{
 		}
 	}; //memblk_
 
+	/**
+	 * @brief 同样大小内存块的分配器. 所有堆在_phead双向链表中, 有空闲块的堆另在_pfree双向链表中,
+	 * 分配总是从_pfree头部的堆取块, 释放时堆由满变为有空闲加入_pfree头部, 全空闲的堆移到_pfree尾部或者直接回收,
+	 * 分配,释放和回收都是O(1), 与堆个数无关.
+	 * @code
+	 * ec::blk_alloctor<ec::null_lock> a(256, 64); // 256字节的块, 每堆64块
+	 * void* p = a.malloc_(nullptr);
+	 * a.free_(p);
+	 * @endcode
+	 */
 	template<class LOCK = null_lock>
 	class blk_alloctor final  // memory block alloctor
 	{
 	protected:
-		memheap_* _phead;
+		memheap_* _phead; // 所有堆, _phead永远不会被回收
+		memheap_* _pfree; // 有空闲块的堆
+		memheap_* _pftail;
+		int32_t _classidx; // 在allocator中的序号, 线程缓存使用
 		int32_t _numheaps; // 堆个数，用于辅助释放空闲堆
 		int32_t _numfreeblks; // 空闲内存块数,用于快速增加堆
 		uint32_t _sizeblk; // 内存块的大小，构造或者初始化时设定,EC_ALLOCTOR_ALIGN字节对齐.
 		uint32_t _numblksperheap; //每个堆里的内存块个数
+#if EC_ALLOCTOR_PROFILE
+		int32_t _numheapspeak{ 0 }; // 堆个数峰值
+#endif
 		LOCK _lck;
 
+		/**
+		 * @brief 大页模式下减少每堆块数使堆大小不超过大页整数倍, 避免按大页取整多占一个大页
+		 * @param sizeblk 已对齐的块大小
+		 * @param numblk 块数
+		 * @return 调整后的块数; 向上取整浪费不多或者减少后浪费仍较多时不调整, 后者blk_sysmalloc使用普通页
+		 */
+		static size_t hugefit_(size_t sizeblk, size_t numblk)
+		{
+#if EC_ALLOCTOR_HUGEPAGE && !defined(_WIN32)
+			const size_t zh = EC_ALLOCTOR_HUGEPAGE_SIZE, zb = sizeblk + EC_ALLOCTOR_ALIGN, zmem = numblk * zb;
+			if (zmem < EC_ALLOCTOR_HUGEPAGE_MINSIZE || (zh - 1 - (zmem - 1) % zh) * EC_ALLOCTOR_HUGEPAGE_WASTE <= zmem)
+				return numblk; // 向上取整浪费不多
+			size_t zdown = zmem - zmem % zh, n = zdown / zb;
+			if (n && zdown >= EC_ALLOCTOR_HUGEPAGE_MINSIZE && (zdown - n * zb) * EC_ALLOCTOR_HUGEPAGE_WASTE <= zdown)
+				return n;
+#endif
+			return numblk;
+		}
+
 		/**
 		 * @brief 计算初始化分配的内存，优化小使用量，第一次分配最大16块或者32KB，之后按照正常预设的额配。
 		 * @param sizeblk 每块大小
@@ -474,6 +668,109 @@ namespace ec{
 			return EC_ALLOCTOR_FIRSTHEAP_SIZE / sizeblk < EC_ALLOCTOR_FIRSTHEAP_BLKS ?
 				EC_ALLOCTOR_FIRSTHEAP_BLKS : EC_ALLOCTOR_FIRSTHEAP_SIZE / sizeblk;
 		}
+
+		inline void linkfree_(memheap_* pheap, bool btail) { // 加入有空闲块的堆链表
+			if (btail) {
+				pheap->_pfnext = nullptr;
+				pheap->_pfprev = _pftail;
+				if (_pftail)
+					_pftail->_pfnext = pheap;
+				else
+					_pfree = pheap;
+				_pftail = pheap;
+			}
+			else {
+				pheap->_pfprev = nullptr;
+				pheap->_pfnext = _pfree;
+				if (_pfree)
+					_pfree->_pfprev = pheap;
+				else
+					_pftail = pheap;
+				_pfree = pheap;
+			}
+		}
+
+		inline void unlinkfree_(memheap_* pheap) {
+			if (pheap->_pfprev)
+				pheap->_pfprev->_pfnext = pheap->_pfnext;
+			else
+				_pfree = pheap->_pfnext;
+			if (pheap->_pfnext)
+				pheap->_pfnext->_pfprev = pheap->_pfprev;
+			else
+				_pftail = pheap->_pfprev;
+			pheap->_pfnext = nullptr;
+			pheap->_pfprev = nullptr;
+		}
+
+		void linkheap_(memheap_* pheap) { // 加入所有堆链表, 2025-3-18改为_phead不变
+			if (!_phead) {
+				_phead = pheap;
+				return;
+			}
+			pheap->_pprev = _phead;
+			pheap->_pnext = _phead->_pnext;
+			if (_phead->_pnext)
+				_phead->_pnext->_pprev = pheap;
+			_phead->_pnext = pheap;
+		}
+
+		void* mallocnl_() { // 无锁分配
+			memheap_* pheap = _pfree;
+			if (!pheap) {
+				pheap = new memheap_(this);
+				if (!pheap)
+					return nullptr;
+				size_t initnumblks = _numblksperheap;
+				if (!_phead) {
+					initnumblks = numInitBlks(_sizeblk, _numblksperheap);
+				}
+				if (!pheap->init(_sizeblk, initnumblks)) {
+					delete pheap;
+					return nullptr;
+				}
+				linkheap_(pheap);
+				linkfree_(pheap, false);
+				_numheaps++;
+#if EC_ALLOCTOR_PROFILE
+				if (_numheaps > _numheapspeak)
+					_numheapspeak = _numheaps;
+#endif
+				_numfreeblks += (int32_t)initnumblks;
+			}
+			void* pret = pheap->malloc_();
+			assert(pret != nullptr);
+			_numfreeblks--;
+			if (pheap->empty())
+				unlinkfree_(pheap);
+			return pret;
+		}
+
+		void freenl_(memheap_* pheap, void* p) { // 无锁释放
+			bool bfull = pheap->empty();
+			pheap->free_(p);
+			_numfreeblks++;
+			if (bfull) {
+				linkfree_(pheap, false);
+				return;
+			}
+			if (!pheap->canfree() || pheap == _phead)
+				return;
+			if (_numheaps > EC_ALLOCTOR_GC_MINHEAPS && _numfreeblks != (int32_t)pheap->numblk()) { // 回收, 至少保留一个空闲堆
+				unlinkfree_(pheap);
+				pheap->_pprev->_pnext = pheap->_pnext;
+				if (pheap->_pnext)
+					pheap->_pnext->_pprev = pheap->_pprev;
+				_numfreeblks -= (int32_t)pheap->numblk();
+				_numheaps--;
+				delete pheap;
+				return;
+			}
+			if (pheap != _pftail) { // 保留的空闲堆放到最后, 优先使用其他堆
+				unlinkfree_(pheap);
+				linkfree_(pheap, true);
+			}
+		}
 	public:
 		inline int32_t numheaps() const	{
 			return _numheaps;
@@ -487,12 +784,26 @@ namespace ec{
 		inline uint32_t numBlksPerHeap() {
 			return _numblksperheap;
 		}
+		inline int32_t classidx() const {
+			return _classidx;
+		}
+#if EC_ALLOCTOR_PROFILE
+		inline int32_t numheapspeak() const {
+			return _numheapspeak;
+		}
+#endif
+		inline void setclassidx(int32_t idx) {
+			_classidx = idx;
+		}
 		static void* operator new(size_t size);
 		static void operator delete(void* p);
 		static void* operator new(size_t size, void* ptr) { return ptr; }
 		static void operator delete(void* ptr, void* voidptr2) noexcept {}
 		blk_alloctor() :
 			_phead(nullptr),
+			_pfree(nullptr),
+			_pftail(nullptr),
+			_classidx(-1),
 			_numheaps(0),
 			_numfreeblks(0),
 			_sizeblk(0),
@@ -500,6 +811,9 @@ namespace ec{
 		}
 		blk_alloctor(size_t sizeblk, size_t numblk) :
 			_phead(nullptr),
+			_pfree(nullptr),
+			_pftail(nullptr),
+			_classidx(-1),
 			_numheaps(0),
 			_numfreeblks(0),
 			_sizeblk(0),
@@ -514,6 +828,8 @@ namespace ec{
 				p = pn;
 			}
 			_phead = nullptr;
+			_pfree = nullptr;
+			_pftail = nullptr;
 			_numheaps = 0;
 			_numfreeblks = 0;
 			_sizeblk = 0;
@@ -523,9 +839,10 @@ namespace ec{
 			if (_phead) {
 				return true;
 			}
+			if (sizeblk % EC_ALLOCTOR_ALIGN)
+				sizeblk += (EC_ALLOCTOR_ALIGN - sizeblk % EC_ALLOCTOR_ALIGN);
+			numblk = hugefit_(sizeblk, numblk);
 			if (!balloc) {
-				if (sizeblk % EC_ALLOCTOR_ALIGN)
-					sizeblk += (EC_ALLOCTOR_ALIGN - sizeblk % EC_ALLOCTOR_ALIGN);
 				_sizeblk = (uint32_t)sizeblk;
 				_numblksperheap = (uint32_t)numblk;
 				return true;
@@ -540,88 +857,60 @@ namespace ec{
 				_phead = nullptr;
 				return false;
 			}
+			linkfree_(_phead, false);
 			_sizeblk = (uint32_t)_phead->sizeblk();
 			_numblksperheap = (uint32_t)numblk;
 			_numheaps = 1;
+#if EC_ALLOCTOR_PROFILE
+			_numheapspeak = 1;
+#endif
 			_numfreeblks += (int)initnumblks;
 			return true;
 		}
 		void* malloc_(size_t* poutsize) {
 			safe_lock<LOCK> lck(&_lck);
-			memheap_* pheap;
-			if (!_numfreeblks) {
-				pheap = new memheap_(this);
-				if (!pheap)
-					return nullptr;
-				size_t initnumblks = _numblksperheap;
-				if (!_phead) {
-					initnumblks = numInitBlks(_sizeblk, _numblksperheap);
-				}
-				if (!pheap->init(_sizeblk, initnumblks)) {
-					delete pheap;
-					return nullptr;
-				}
-				if (!_phead) {
-					_phead = pheap;
-				}
-				else { //2025-3-18改为_phead不变
-					pheap->_pnext = _phead->_pnext;
-					_phead->_pnext = pheap;
-				}
-				_numheaps++;
-				_numfreeblks += (int32_t)(initnumblks - 1);
-				if (poutsize) {
-					*poutsize = _sizeblk;
-				}
-				return pheap->malloc_();
-			}
-			void* pret = nullptr;
-			memheap_* pprior = nullptr;
-			pheap = _phead;
-			while (pheap) {
-				if (nullptr != (pret = pheap->malloc_())) {
-					_numfreeblks--;
-					if (poutsize) {
-						*poutsize = _sizeblk;
-					}
-					if (pprior && pprior != _phead && pheap->numfree() > 0) { // move to head->next for next fast malloc
-						pprior->_pnext = pheap->_pnext;
-						pheap->_pnext = _phead->_pnext;
-						_phead->_pnext = pheap;
-					}
-					return pret;
-				}
-				pprior = pheap;
-				pheap = pheap->_pnext;
+			void* pret = mallocnl_();
+			if (pret && poutsize) {
+				*poutsize = _sizeblk;
 			}
-			assert(pret != nullptr);
-			return nullptr;
+			return pret;
+		}
+
+		/**
+		 * @brief 一次加锁分配多块, 用于线程缓存补充
+		 * @return 分配的块数
+		 */
+		int malloc_batch(void** pout, int num) {
+			safe_lock<LOCK> lck(&_lck);
+			int n = 0;
+			while (n < num && nullptr != (pout[n] = mallocnl_()))
+				++n;
+			return n;
 		}
 		bool free_(void* p) {// for single allotor such as ec::hashmap
 			memheap_** pheap = (memheap_**)(static_cast<char*>(p) - EC_ALLOCTOR_ALIGN);
 			assert(*pheap);
 			_lck.lock();
 			assert((*pheap)->getalloc() == this);
-			(*pheap)->free_(p);
-			_numfreeblks++;
-			if (_numheaps > EC_ALLOCTOR_GC_MINHEAPS && (*pheap)->canfree() && (*pheap) != _phead
-				&& _numfreeblks != (int32_t)_numblksperheap) {
-				gc_();
-			}
+			freenl_(*pheap, p);
 			_lck.unlock();
 			return true;
 		}
 		bool free_(memheap_* pheap, void* p) { // for multiple allotor
 			_lck.lock();
-			pheap->free_(p);
-			_numfreeblks++;
-			if (_numheaps > EC_ALLOCTOR_GC_MINHEAPS && pheap->canfree() && pheap != _phead
-				&& _numfreeblks != (int32_t)_numblksperheap) {
-				gc_();
-			}
+			freenl_(pheap, p);
 			_lck.unlock();
 			return true;
 		}
+
+		/**
+		 * @brief 一次加锁释放多块, 用于线程缓存归还
+		 */
+		void free_batch(void* const* pblks, int num) {
+			safe_lock<LOCK> lck(&_lck);
+			for (int i = 0; i < num; i++)
+				freenl_(*(memheap_**)(static_cast<char*>(pblks[i]) - EC_ALLOCTOR_ALIGN), pblks[i]);
+		}
 		size_t numfree() {// for debug
 			safe_lock<LOCK> lck(&_lck);
 			size_t zr = 0u;
@@ -632,30 +921,6 @@ namespace ec{
 			}
 			return zr;
 		}
-	private:
-		int gc_() { //garbage collection
-			int n = 0;
-			memheap_* p = _phead; //_phead永远不会被回收
-			memheap_* pnext;
-			if (!p) {
-				return n;
-			}
-			pnext = p->_pnext;
-			while (pnext) {
-				if (pnext->canfree()) {
-					p->_pnext = pnext->_pnext;
-					delete pnext;
-					_numheaps--;
-					_numfreeblks -= (int)(_numblksperheap);
-					n++;
-				}
-				else {
-					p = pnext;
-				}
-				pnext = p->_pnext;
-			}
-			return n;
-		}
 	};
 
 	class allocator final
@@ -665,19 +930,249 @@ namespace ec{
 		unsigned int _size;
 		std::atomic_int _nLargeMems{ 0 };// Number of remaining large memory blocks, used for memory leak detection
 		PA_ _alloctors[EC_SIZE_BLK_ALLOCATOR];
+		uint32_t _sizes[EC_SIZE_BLK_ALLOCATOR]; // 块大小, 查找时不访问blk_alloctor
+		uint8_t _lutsml[EC_ALLOCTOR_LUT_SMLSIZE / 8 + 1]; // [(size + 7) / 8]: 块序号
+		uint8_t _lutlog[65]; // [size - 1的位数]: 可能满足的第一个块序号
+
+		static inline unsigned int sizebits_(uint64_t v) { // v > 0
+#if defined(_MSC_VER) && defined(_M_AMD64)
+			unsigned long index;
+			_BitScanReverse64(&index, v);
+			return (unsigned int)index + 1;
+#elif defined(__GNUC__)
+			return 64u - (unsigned int)__builtin_clzll(v);
+#else
+			unsigned int n = 0;
+			while (v) {
+				v >>= 1;
+				++n;
+			}
+			return n;
+#endif
+		}
+
+		void buildlut_() {
+			unsigned int i = 0;
+			for (size_t k = 0; k < sizeof(_lutsml); k++) {
+				while (i < _size && _sizes[i] < k * 8)
+					++i;
+				_lutsml[k] = (uint8_t)i;
+			}
+			for (unsigned int b = 0; b < sizeof(_lutlog); b++) {
+				uint64_t zlow = b ? 1ull << (b - 1) : 0; // size在(zlow, 2 * zlow]
+				for (i = 0; i < _size && _sizes[i] <= zlow; i++);
+				_lutlog[b] = (uint8_t)i;
+			}
+		}
+
+		/**
+		 * @brief 块序号
+		 * @return 满足size的最小块序号; _size:大内存
+		 */
+		inline unsigned int classidx_(size_t size) const {
+			if (size <= EC_ALLOCTOR_LUT_SMLSIZE)
+				return _lutsml[(size + 7) >> 3];
+			unsigned int i = _lutlog[sizebits_(size - 1)];
+			while (i < _size && _sizes[i] < size)
+				++i;
+			return i;
+		}
+#if EC_ALLOCTOR_TCACHE
+		unsigned int _tcclasses{ 0 }; // 使用线程缓存的块种类数, 为_alloctors的前_tcclasses个
+
+		/**
+		 * @brief 线程缓存, 每种小内存块一个后进先出的块栈(magazine). 空时从blk_alloctor批量补充一半, 满时归还较早的一半,
+		 * 其他线程分配的块释放时进入释放线程的缓存, 批量归还到共享的blk_alloctor. 线程退出时全部归还.
+		 */
+		class tcache_ final
+		{
+		public:
+			struct t_mag {
+				uint32_t _num; // 缓存的块数
+				uint32_t _cap; // 容量
+				void* _blks[EC_ALLOCTOR_TCACHE_BLKS];
+			};
+			allocator* _palloc; // 绑定的allocator
+			int* _pstate;
+			t_mag _mags[EC_ALLOCTOR_TCACHE_CLASSES];
+
+			tcache_(int* pstate) : _palloc(nullptr), _pstate(pstate) {
+				for (auto& i : _mags) {
+					i._num = 0;
+					i._cap = 0;
+				}
+				*_pstate = 1;
+			}
+			~tcache_() {
+				*_pstate = 2;
+				if (!_palloc)
+					return;
+				for (auto i = 0u; i < _palloc->_tcclasses; i++) {
+					if (_mags[i]._num) {
+						_palloc->_alloctors[i]->free_batch(_mags[i]._blks, (int)_mags[i]._num);
+						_mags[i]._num = 0;
+					}
+				}
+			}
+			void bind(allocator* palloc) {
+				_palloc = palloc;
+				for (auto i = 0u; i < palloc->_tcclasses; i++) {
+					size_t n = EC_ALLOCTOR_TCACHE_BYTES / palloc->_alloctors[i]->sizeblk();
+					_mags[i]._cap = (uint32_t)(n < 2 ? 2 : (n > EC_ALLOCTOR_TCACHE_BLKS ? EC_ALLOCTOR_TCACHE_BLKS : n));
+				}
+			}
+		};
+
+		/**
+		 * @brief 当前线程的缓存
+		 * @return 线程缓存; nullptr:线程正在退出或者已绑定其他allocator
+		 */
+		tcache_* tcache() {
+			static thread_local int tcstate = 0; // 0:未创建; 1:可用; 2:已析构
+			static thread_local tcache_* ptc = nullptr;
+			if (1 != tcstate) {
+				if (tcstate)
+					return nullptr;
+				static thread_local tcache_ tc(&tcstate);
+				ptc = &tc;
+			}
+			if (ptc->_palloc != this) {
+				if (ptc->_palloc)
+					return nullptr;
+				ptc->bind(this);
+			}
+			return ptc;
+		}
+#endif
+#if EC_ALLOCTOR_PROFILE
+		struct t_pfcount { // 分配统计
+			std::atomic<uint64_t> _allocs{ 0 };
+			std::atomic<uint64_t> _frees{ 0 };
+			std::atomic<int64_t> _live{ 0 }; // 使用中的块数
+			std::atomic<int64_t> _peak{ 0 }; // 使用中的块数峰值
+			std::atomic<uint64_t> _lockops{ 0 }; // 调用blk_alloctor加锁次数
+			std::atomic<uint64_t> _lockns{ 0 }; // 加锁调用耗时(含等待),纳秒
+			std::atomic<int64_t> _bytes{ 0 }; // 大内存使用中的字节数
+			std::atomic<int64_t> _peakbytes{ 0 };
+			void reset() {
+				_allocs = 0;
+				_frees = 0;
+				_peak = _live.load();
+				_lockops = 0;
+				_lockns = 0;
+				_peakbytes = _bytes.load();
+			}
+		};
+		struct t_pfsample { // 调用栈采样
+			size_t _size; // 申请大小
+			uint32_t _sizeblk; // 块大小, 0:大内存
+			int _nframes;
+			void* _frames[EC_ALLOCTOR_PROFILE_FRAMES];
+		};
+		t_pfcount _pfclass[EC_SIZE_BLK_ALLOCATOR];
+		t_pfcount _pflarge;
+		std::atomic<uint64_t> _pfseq{ 0 };
+		spinlock _pflck; // 保护采样
+		uint32_t _pfnext{ 0 }; // 采样写位置
+		uint32_t _pfnum{ 0 }; // 采样数
+		t_pfsample _pfsamples[EC_ALLOCTOR_PROFILE_SAMPLES];
+
+		static inline int64_t pfnow_() {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static inline void pfmax_(std::atomic<int64_t>& vmax, int64_t v) {
+			int64_t vcur = vmax.load(std::memory_order_relaxed);
+			while (v > vcur && !vmax.compare_exchange_weak(vcur, v, std::memory_order_relaxed));
+		}
+
+		/**
+		 * @brief 加锁调用计时
+		 */
+		class pflock_ final {
+			t_pfcount& _c;
+			int64_t _ns;
+		public:
+			pflock_(t_pfcount& c) : _c(c), _ns(pfnow_()) {
+			}
+			~pflock_() {
+				_c._lockns.fetch_add((uint64_t)(pfnow_() - _ns), std::memory_order_relaxed);
+				_c._lockops.fetch_add(1, std::memory_order_relaxed);
+			}
+		};
+
+		void pfalloc_(t_pfcount& c, size_t size, uint32_t sizeblk, int64_t bytes) {
+			c._allocs.fetch_add(1, std::memory_order_relaxed);
+			pfmax_(c._peak, c._live.fetch_add(1, std::memory_order_relaxed) + 1);
+			if (bytes)
+				pfmax_(c._peakbytes, c._bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+			if (EC_ALLOCTOR_PROFILE_SAMPLE && !((_pfseq.fetch_add(1, std::memory_order_relaxed) + 1) % EC_ALLOCTOR_PROFILE_SAMPLE))
+				pfsample_(size, sizeblk);
+		}
+
+		/**
+		 * @brief 采样调用栈, 不内联以便跳过自身一帧; 视内联情况前1-2帧可能是pfalloc_/malloc_
+		 */
+#ifdef _WIN32
+		__declspec(noinline)
+#else
+		__attribute__((noinline))
+#endif
+		void pfsample_(size_t size, uint32_t sizeblk) {
+			void* frames[EC_ALLOCTOR_PROFILE_FRAMES + 1];
+#ifdef _WIN32
+			int n = (int)CaptureStackBackTrace(1, EC_ALLOCTOR_PROFILE_FRAMES, frames, nullptr);
+			void** pf = frames;
+#else
+			int n = backtrace(frames, EC_ALLOCTOR_PROFILE_FRAMES + 1) - 1;
+			void** pf = frames + 1;
+#endif
+			if (n < 0)
+				n = 0;
+			safe_lock<spinlock> lck(&_pflck);
+			t_pfsample& smp = _pfsamples[_pfnext];
+			smp._size = size;
+			smp._sizeblk = sizeblk;
+			smp._nframes = n;
+			memcpy(smp._frames, pf, n * sizeof(void*));
+			_pfnext = (_pfnext + 1) % EC_ALLOCTOR_PROFILE_SAMPLES;
+			if (_pfnum < EC_ALLOCTOR_PROFILE_SAMPLES)
+				++_pfnum;
+		}
+
+		inline void pffree_(t_pfcount& c, int64_t bytes) {
+			c._frees.fetch_add(1, std::memory_order_relaxed);
+			c._live.fetch_sub(1, std::memory_order_relaxed);
+			if (bytes)
+				c._bytes.fetch_sub(bytes, std::memory_order_relaxed);
+		}
+
+		template<class STR_>
+		static void pfcountjs_(STR_& sout, const t_pfcount& c) {
+			char stmp[400];
+			int nl = snprintf(stmp, sizeof(stmp), "\"allocs\":%llu,\"frees\":%llu,\"live\":%lld,\"peakLive\":%lld,\"lockOps\":%llu,\"lockNs\":%llu",
+				(unsigned long long)c._allocs.load(), (unsigned long long)c._frees.load(), (long long)c._live.load(),
+				(long long)c._peak.load(), (unsigned long long)c._lockops.load(), (unsigned long long)c._lockns.load());
+			if (nl < (int)sizeof(stmp))
+				sout.append(stmp, nl);
+		}
+#endif
 	private:
 		void* largeMalloc(size_t size, size_t* psize = nullptr) {
 			size += EC_ALLOCTOR_LARGEMEM_HEADSIZE;
 			size_t zlen = 0;
 			char* ptr = (char*)blk_sysmalloc(size, &zlen);
-			if (ptr) {
-				memset(ptr, 0, EC_ALLOCTOR_LARGEMEM_HEADSIZE);
-				*((size_t*)ptr) = zlen;
-				if (psize) {
-					*psize = zlen - EC_ALLOCTOR_LARGEMEM_HEADSIZE;
-				}
-				++_nLargeMems;
+			if (!ptr)
+				return nullptr;
+			memset(ptr, 0, EC_ALLOCTOR_LARGEMEM_HEADSIZE);
+			*((size_t*)ptr) = zlen;
+			if (psize) {
+				*psize = zlen - EC_ALLOCTOR_LARGEMEM_HEADSIZE;
 			}
+			++_nLargeMems;
+#if EC_ALLOCTOR_PROFILE
+			pfalloc_(_pflarge, size - EC_ALLOCTOR_LARGEMEM_HEADSIZE, 0, (int64_t)zlen);
+#endif
 			return ptr + EC_ALLOCTOR_LARGEMEM_HEADSIZE;
 		}
 
@@ -686,6 +1181,9 @@ namespace ec{
 				return false;
 			size_t* pmem = (size_t*)(reinterpret_cast<char*>(ptr) - EC_ALLOCTOR_LARGEMEM_HEADSIZE);
 			--_nLargeMems;
+#if EC_ALLOCTOR_PROFILE
+			pffree_(_pflarge, (int64_t)*pmem);
+#endif
 			return blk_sysfree(pmem, *pmem);
 		}
 	public:
@@ -697,11 +1195,19 @@ namespace ec{
 				delete p;
 				return false;
 			}
+			p->setclassidx((int32_t)_size);
+			_sizes[_size] = (uint32_t)p->sizeblk();
 			_alloctors[_size++] = p;
+			buildlut_();
+#if EC_ALLOCTOR_TCACHE
+			if (_tcclasses + 1 == _size && _tcclasses < EC_ALLOCTOR_TCACHE_CLASSES && p->sizeblk() <= EC_ALLOCTOR_TCACHE_MAXSIZE)
+				++_tcclasses;
+#endif
 			return true;
 		}
 	public:
 		allocator() :_size(0), _alloctors{ nullptr } {
+			buildlut_();
 		}
 		~allocator() {
 			for (auto i = 0u; i < _size; i++) {
@@ -716,18 +1222,41 @@ namespace ec{
 			return 0u == _size ? 0 : _alloctors[_size - 1]->sizeblk();
 		}
 		void* malloc_(size_t size, size_t* psize = nullptr) {
-			int nl = 0, nh = static_cast<int>(_size), nm;
-			while (nl < nh) {
-				nm = nl + (nh - nl) / 2;
-				if (_alloctors[nm]->sizeblk() < size) {
-					nl = nm + 1;
+			int nl = (int)classidx_(size);
+			if (nl < (int)_size) {
+#if EC_ALLOCTOR_TCACHE
+				tcache_* ptc;
+				if (nl < (int)_tcclasses && nullptr != (ptc = tcache())) {
+					tcache_::t_mag& mag = ptc->_mags[nl];
+					if (!mag._num) {
+#if EC_ALLOCTOR_PROFILE
+						pflock_ pftm(_pfclass[nl]);
+#endif
+						mag._num = (uint32_t)_alloctors[nl]->malloc_batch(mag._blks, (int)(mag._cap / 2));
+						if (!mag._num)
+							return nullptr;
+					}
+					if (psize)
+						*psize = _alloctors[nl]->sizeblk();
+#if EC_ALLOCTOR_PROFILE
+					pfalloc_(_pfclass[nl], size, _sizes[nl], 0);
+#endif
+					return mag._blks[--mag._num];
 				}
-				else {
-					nh = nm;
+#endif
+#if EC_ALLOCTOR_PROFILE
+				void* pret;
+				{
+					pflock_ pftm(_pfclass[nl]);
+					pret = _alloctors[nl]->malloc_(psize);
 				}
-			}
-			if (nl < (int)_size)
+				if (pret)
+					pfalloc_(_pfclass[nl], size, _sizes[nl], 0);
+				return pret;
+#else
 				return _alloctors[nl]->malloc_(psize);
+#endif
+			}
 			return largeMalloc(size, psize);
 		}
 		void* realloc_(void* ptr, size_t size, size_t* poutsize = nullptr) {
@@ -763,10 +1292,39 @@ namespace ec{
 			memheap_** pheap = (memheap_**)(reinterpret_cast<char*>(p) - EC_ALLOCTOR_ALIGN);
 			if (!*pheap) {
 				largeFree(p);
+				return;
 			}
-			else {
-				reinterpret_cast<blk_alloctor<spinlock>*>((*pheap)->getalloc())->free_(*pheap, p);
+			blk_alloctor<spinlock>* pa = reinterpret_cast<blk_alloctor<spinlock>*>((*pheap)->getalloc());
+			uint32_t ci = (uint32_t)pa->classidx(); // 不是本分配器的blk_alloctor时为-1, 转为无符号后不使用线程缓存和统计
+#if EC_ALLOCTOR_PROFILE
+			if (ci < _size)
+				pffree_(_pfclass[ci], 0);
+#endif
+#if EC_ALLOCTOR_TCACHE
+			tcache_* ptc;
+			if (ci < _tcclasses && nullptr != (ptc = tcache())) {
+				tcache_::t_mag& mag = ptc->_mags[ci];
+				if (mag._num == mag._cap) { // 归还较早的一半, 保留最近释放的
+#if EC_ALLOCTOR_PROFILE
+					pflock_ pftm(_pfclass[ci]);
+#endif
+					uint32_t n = mag._cap / 2;
+					pa->free_batch(mag._blks, (int)n);
+					mag._num -= n;
+					memmove(mag._blks, mag._blks + n, mag._num * sizeof(void*));
+				}
+				mag._blks[mag._num++] = p;
+				return;
 			}
+#endif
+#if EC_ALLOCTOR_PROFILE
+			if (ci < _size) {
+				pflock_ pftm(_pfclass[ci]);
+				pa->free_(*pheap, p);
+				return;
+			}
+#endif
+			pa->free_(*pheap, p);
 		}
 		int prtinfo() { // for debug
 			printf("\nprintf ec::alloctor{\n");
@@ -818,6 +1376,60 @@ namespace ec{
 					sout.append(stmp, nl);
 			}
 		}
+#if EC_ALLOCTOR_PROFILE
+		/**
+		 * @brief 输出分配统计JSON, 采样的返回地址可用addr2line -f -C -e 程序名 地址解析
+		 * @code
+		 * {"sample":4096,"classes":[{"blockSize":16,"blockPerHeap":65536,"numHeaps":1,"peakHeaps":1,"allocs":0,...}],
+		 *  "large":{"allocs":0,"frees":0,"live":0,"peakLive":0,"lockOps":0,"lockNs":0,"bytes":0,"peakBytes":0},
+		 *  "samples":[{"size":100,"blockSize":128,"frames":["0x4012a0",...]}]}
+		 * @endcode
+		 */
+		template<class STR_>
+		void profilejs(STR_& sout) {
+			char stmp[400];
+			int nl = snprintf(stmp, sizeof(stmp), "{\"sample\":%d,\"classes\":[", (int)EC_ALLOCTOR_PROFILE_SAMPLE);
+			sout.append(stmp, nl);
+			for (auto i = 0u; i < _size; i++) {
+				nl = snprintf(stmp, sizeof(stmp), "%s{\"blockSize\":%zu,\"blockPerHeap\":%u,\"numHeaps\":%d,\"peakHeaps\":%d,",
+					i ? "," : "", _alloctors[i]->sizeblk(), _alloctors[i]->numBlksPerHeap(), _alloctors[i]->numheaps(),
+					_alloctors[i]->numheapspeak());
+				if (nl < (int)sizeof(stmp))
+					sout.append(stmp, nl);
+				pfcountjs_(sout, _pfclass[i]);
+				sout.push_back('}');
+			}
+			sout.append("],\"large\":{");
+			pfcountjs_(sout, _pflarge);
+			nl = snprintf(stmp, sizeof(stmp), ",\"bytes\":%lld,\"peakBytes\":%lld},\"samples\":[",
+				(long long)_pflarge._bytes.load(), (long long)_pflarge._peakbytes.load());
+			sout.append(stmp, nl);
+			safe_lock<spinlock> lck(&_pflck);
+			for (auto i = 0u; i < _pfnum; i++) {
+				const t_pfsample& smp = _pfsamples[(_pfnext + EC_ALLOCTOR_PROFILE_SAMPLES - _pfnum + i) % EC_ALLOCTOR_PROFILE_SAMPLES];
+				nl = snprintf(stmp, sizeof(stmp), "%s{\"size\":%zu,\"blockSize\":%u,\"frames\":[", i ? "," : "", smp._size, smp._sizeblk);
+				sout.append(stmp, nl);
+				for (int k = 0; k < smp._nframes; k++) {
+					nl = snprintf(stmp, sizeof(stmp), "%s\"%p\"", k ? "," : "", smp._frames[k]);
+					sout.append(stmp, nl);
+				}
+				sout.append("]}");
+			}
+			sout.append("]}");
+		}
+
+		/**
+		 * @brief 清零累计计数和采样, 峰值重置为当前值
+		 */
+		void profilereset() {
+			for (auto i = 0u; i < _size; i++)
+				_pfclass[i].reset();
+			_pflarge.reset();
+			safe_lock<spinlock> lck(&_pflck);
+			_pfnext = 0;
+			_pfnum = 0;
+		}
+#endif
 	};
 	constexpr size_t zbaseobjsize = sizeof(memheap_) > sizeof(blk_alloctor<spinlock>) ? sizeof(memheap_) : sizeof(blk_alloctor<spinlock>);
 	constexpr size_t zselfblksize = (zbaseobjsize % 8u) ? zbaseobjsize + 8u - zbaseobjsize % 8u : zbaseobjsize;
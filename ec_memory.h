@@ -3,6 +3,10 @@
 \author	jiangyong
 \email  kipway@outlook.com
 \update
+  2026-10-16 io_buffer::appendref() allocate header and ref blocks before linking, no half frame on failure
+  2026-10-16 add parsebuffer::writebuf() and commit() for recv in place
+  2026-10-16 add class refbuf and io_buffer::appendref() for zero-copy send
+  2026-10-16 add io_buffer::getiov() for writev/sendmsg
   2024-12-05 add io_buffer::setsizemax() and parsebuffer::bufsize()
   2024-12-02 update with ec_alloctor.h
   2024-11-25 add class ec::blk_alloctor_g
@@ -19,6 +23,9 @@
 autobuf
 	buffer class auto free memory
 
+refbuf
+	reference counted buffer, shared by io_buffer
+
 io_buffer
 	for net io send
 
@@ -37,6 +44,7 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #include <cstdint>
 #include <memory.h>
 #include <vector>
+#include <atomic>
 #include "ec_mutex.h"
 
 #ifndef _HAS_EC_ALLOCTOR
@@ -93,6 +101,57 @@ namespace ec {
 #endif
 	}
 
+	/**
+	 * @brief 引用计数缓冲, 多个io_buffer共享同一数据不拷贝, 最后一个release()时释放
+	*/
+	class refbuf final
+	{
+	private:
+		std::atomic_int _nref;
+		size_t _size;
+		refbuf(size_t size) : _nref(1), _size(size) {
+		}
+		~refbuf() {
+		}
+	public:
+		/**
+		 * @brief 创建, 引用计数为1
+		 * @param pdata 数据, 为nullptr时只分配空间
+		 * @param size 数据长度
+		 * @return nullptr:failed
+		*/
+		static refbuf* create(const void* pdata, size_t size)
+		{
+			void* p = ec::g_malloc(sizeof(refbuf) + size);
+			if (!p)
+				return nullptr;
+			refbuf* pr = new(p)refbuf(size);
+			if (pdata && size)
+				memcpy(pr->data(), pdata, size);
+			return pr;
+		}
+		inline uint8_t* data()
+		{
+			return (uint8_t*)this + sizeof(refbuf);
+		}
+		inline size_t size() const
+		{
+			return _size;
+		}
+		inline refbuf* addref()
+		{
+			_nref.fetch_add(1, std::memory_order_relaxed);
+			return this;
+		}
+		void release()
+		{
+			if (1 == _nref.fetch_sub(1, std::memory_order_acq_rel)) {
+				this->~refbuf();
+				ec::g_free(this);
+			}
+		}
+	};
+
 	template <typename _Tp = char>
 	class autobuf
 	{
@@ -233,11 +292,18 @@ namespace ec {
 	class io_buffer // net IO bytes buffer,用于发送缓冲
 	{
 	public:
+		enum blktype_ {
+			blk_pool = 0, // _pallocator分配的块
+			blk_heap = 1, // g_malloc分配的小块,已满
+			blk_ref = 2   // 引用块, 数据在pref中
+		};
 		struct blk_ {
 			uint32_t pos; // read position
 			uint32_t len; // append position
 			blk_* pnext; //next block
-			blk_() :pos(0), len(0), pnext(nullptr) {}
+			refbuf* pref; //blk_ref
+			int type; //blktype_
+			blk_() :pos(0), len(0), pnext(nullptr), pref(nullptr), type(blk_pool) {}
 		};
 	private:
 		BLK_ALLOCTOR* _pallocator;//块分配器
@@ -250,6 +316,31 @@ namespace ec {
 			return (char*)pblk_ + sizeof(blk_);
 		}
 
+		char* blkdata_(blk_* pblk_) {
+			return blk_ref == pblk_->type ? (char*)pblk_->pref->data() : pdata_(pblk_);
+		}
+
+		void freeblk_(blk_* pblk_) {
+			if (blk_pool == pblk_->type)
+				_pallocator->free_(pblk_);
+			else {
+				if (pblk_->pref)
+					pblk_->pref->release();
+				ec::g_free(pblk_);
+			}
+		}
+
+		void linkblk_(blk_* pblk_) {
+			if (!_phead) {
+				_ptail = pblk_;
+				_phead = _ptail;
+			}
+			else {
+				_ptail->pnext = pblk_;
+				_ptail = pblk_;
+			}
+		}
+
 		size_t blkappend(blk_* pblk, const uint8_t* p, size_t len) // return numbytes append to pblk
 		{
 			if (!p || !len)
@@ -309,7 +400,7 @@ namespace ec {
 			blk_* pnext;
 			while (_phead) {
 				pnext = _phead->pnext;
-				_pallocator->free_(_phead);
+				freeblk_(_phead);
 				_phead = pnext;
 			}
 			_phead = nullptr;
@@ -326,7 +417,7 @@ namespace ec {
 		}
 
 		inline bool blkfull(blk_* pblk) {
-			return blksize() == pblk->len;
+			return blk_pool != pblk->type || blksize() == pblk->len;
 		}
 
 		inline bool oversize() {
@@ -389,6 +480,62 @@ namespace ec {
 			return true;
 		}
 
+		/**
+		 * @brief 追加引用块,不拷贝数据,增加pref的引用计数。
+		 * @param pref 引用缓冲
+		 * @param offset pref中的开始位置
+		 * @param size 长度
+		 * @param phead 可选前缀数据(比如websocket帧头),会拷贝
+		 * @param headsize 前缀长度
+		 * @return true:success; false:failed
+		*/
+		bool appendref(refbuf* pref, size_t offset, size_t size, const void* phead = nullptr, size_t headsize = 0)
+		{
+			if (!pref || offset + size > pref->size() || offset + size > UINT32_MAX || oversize())
+				return false;
+			blk_* ph = nullptr, * p = nullptr; // 两块都分配成功后再链接, 避免只追加了帧头
+			if (phead && headsize) {
+				if (nullptr == (ph = (blk_*)ec::g_malloc(sizeof(blk_) + headsize)))
+					return false;
+			}
+			if (size && nullptr == (p = (blk_*)ec::g_malloc(sizeof(blk_)))) {
+				if (ph)
+					ec::g_free(ph);
+				return false;
+			}
+			if (ph) {
+				new(ph)blk_();
+				ph->type = blk_heap;
+				memcpy(pdata_(ph), phead, headsize);
+				ph->len = (uint32_t)headsize;
+				linkblk_(ph);
+				_size += headsize;
+			}
+			if (p) {
+				new(p)blk_();
+				p->type = blk_ref;
+				p->pref = pref->addref();
+				p->pos = (uint32_t)offset;
+				p->len = (uint32_t)(offset + size);
+				linkblk_(p);
+				_size += size;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief 头部数据块是否是引用块
+		 * @return -1:空; 0:不是; 1:是
+		*/
+		int headref()
+		{
+			for (blk_* p = _phead; p; p = p->pnext) {
+				if (p->pos != p->len)
+					return blk_ref == p->type ? 1 : 0;
+			}
+			return -1;
+		}
+
 		//从头部获取数据块,返回数据库指针,zlen回填长度。无拷贝
 		const void* get(size_t& zlen)
 		{
@@ -398,7 +545,7 @@ namespace ec {
 			while (_phead) {
 				if (_phead->pos == _phead->len) {
 					pnext = _phead->pnext;
-					_pallocator->free_(_phead);
+					freeblk_(_phead);
 					_phead = pnext;
 					if (!_phead) {
 						_ptail = nullptr;
@@ -406,14 +553,45 @@ namespace ec {
 					}
 					continue;
 				}
-				pret = (const uint8_t*)pdata_(_phead) + _phead->pos;
+				pret = (const uint8_t*)blkdata_(_phead) + _phead->pos;
 				zlen = _phead->len - _phead->pos;
 				break;
 			}
 			return pret;
 		}
 
-		//从头部开始释放zlen长度数据,当调用get后使用。
+		/**
+		 * @brief 从头部获取最多numiov个数据块的iovec视图,用于writev/sendmsg一次发送多块,发送后使用freesize()释放。无拷贝
+		 * @param piov iovec数组, 成员为iov_base, iov_len
+		 * @param numiov piov数组大小
+		 * @param pzbytes 回填总字节数, 可为nullptr
+		 * @param blkref -1:所有块; 0:只取头部连续的非引用块; 1:只取头部连续的引用块
+		 * @param prefs blkref为1时回填每个iovec对应的引用缓冲(不增加引用计数), 可为nullptr
+		 * @return 填充的iovec个数
+		*/
+		template<class _IOV>
+		int getiov(_IOV* piov, int numiov, size_t* pzbytes = nullptr, int blkref = -1, refbuf** prefs = nullptr)
+		{
+			int n = 0;
+			size_t zt = 0;
+			for (blk_* p = _phead; p && n < numiov; p = p->pnext) {
+				if (p->pos == p->len)
+					continue;
+				if (blkref >= 0 && blkref != (blk_ref == p->type ? 1 : 0))
+					break;
+				if (prefs)
+					prefs[n] = p->pref;
+				piov[n].iov_base = blkdata_(p) + p->pos;
+				piov[n].iov_len = p->len - p->pos;
+				zt += piov[n].iov_len;
+				++n;
+			}
+			if (pzbytes)
+				*pzbytes = zt;
+			return n;
+		}
+
+		//从头部开始释放zlen长度数据,当调用get或getiov后使用。
 		void freesize(size_t zlen)
 		{
 			blk_* pnext;
@@ -427,7 +605,7 @@ namespace ec {
 				else {
 					zfree += _phead->len - _phead->pos;
 					pnext = _phead->pnext;
-					_pallocator->free_(_phead);
+					freeblk_(_phead);
 					_phead = pnext;
 					if (!_phead)
 						_ptail = nullptr;
@@ -551,6 +729,50 @@ namespace ec {
 			return _pbuf + _head;
 		}
 
+		/**
+		 * @brief 获取尾部至少size字节的可写空间, 用于直接读入数据, 写入后调用commit()
+		 * @param size 需要的可写字节数
+		 * @return 可写空间开始位置, nullptr:内存分配失败
+		*/
+		void* writebuf(size_t size)
+		{
+			if (!_pbuf) {
+				_pbuf = (uint8_t*)malloc_(size, _bufsize);
+				if (!_pbuf)
+					return nullptr;
+				_pos = 0;
+				_head = 0;
+				_tail = 0;
+				return _pbuf;
+			}
+			if (_tail + size <= _bufsize)
+				return _pbuf + _tail;
+			size_t oldsize = _tail - _head;
+			if (oldsize + size <= _bufsize) { //移到头部
+				memmove(_pbuf, _pbuf + _head, oldsize);
+				_head = 0;
+				_tail = oldsize;
+				return _pbuf + _tail;
+			}
+			size_t newbufsize = oldsize + size;
+			newbufsize += newbufsize / 2;
+			uint8_t* pnew = (uint8_t*)malloc_(newbufsize, newbufsize);
+			if (!pnew)
+				return nullptr;
+			memcpy(pnew, _pbuf + _head, oldsize);
+			_head = 0;
+			_tail = oldsize;
+			_bufsize = newbufsize;
+			free_(_pbuf);
+			_pbuf = pnew;
+			return _pbuf + _tail;
+		}
+
+		inline void commit(size_t size) //确认writebuf()写入的size字节
+		{
+			_tail = _tail + size <= _bufsize ? _tail + size : _bufsize;
+		}
+
 		void freehead(size_t size) //从头释放size字节
 		{
 			if (!_pbuf)
@@ -4,6 +4,20 @@
 * 
 * @author jiangyong
 * @update
+  2026-10-16 关闭连接时内核未完成的MSG_ZEROCOPY引用保留EC_AIO_ZEROCOPY_LINGER毫秒后释放; 延迟断开中的会话不使用MSG_ZEROCOPY
+  2026-10-16 eventfd创建或加入epoll失败时open()返回-1, 避免wakeup()失效
+  2026-10-16 增加热重启交接用的tcplisten_fd(),tcpaccept_fd(),pauselisten(),detachfd()
+  2026-10-16 EC_AIO_PROFILE时统计epoll_wait等待和每个事件的处理耗时, 慢事件记录日志
+  2026-10-16 增加_ustwaitend, 用于统计事件处理耗时
+  2026-10-16 增加发送限速sizeCanSend()
+  2026-10-16 runtime_返回处理的事件数
+  2026-10-16 EC_AIO_RECV_INPLACE模式下支持的会话直接读入会话的_rbuf
+  2026-10-16 监听事件循环accept直到EAGAIN或达到单次上限(EC_AIO_ACCEPT_ONCE), accept日志改为每秒汇总
+  2026-10-16 增加引用块的MSG_ZEROCOPY发送和完成通知处理
+  2026-10-16 UDP使用recvmmsg/sendmmsg批量收发,增加批量接收回调onReceivedFromBatch()
+  2026-10-16 sendbuf使用sendmsg一次发送多个发送缓冲块
+  2026-10-16 缓存已注册的epoll事件,未变化时不再EPOLL_CTL_MOD; 增加EPOLLET模式(EC_AIO_EPOLLET)
+  2026-10-16 增加SO_REUSEPORT监听,fd分组和跨线程唤醒,支持多reactor
   2024-12-30 优化udp的发送
   2024-11-9 support no ec_alloctor
   2024-5-8 增加主动断开处理，用于发送websocket断开控制帧。
@@ -28,6 +42,7 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #include "ec_log.h"
 #include "ec_map.h"
 #include "ec_vector.hpp"
+#include <atomic>
 #ifndef SIZE_MAX_FD
 #define SIZE_MAX_FD  16384 //最大fd连接数
 #endif
@@ -38,19 +53,94 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #ifndef FRMS_UDP_SEND_ONCE
 #define FRMS_UDP_SEND_ONCE 8
 #endif
+#ifndef EC_UDP_READ_FRMSIZE
+#ifdef _MEM_TINY
+#define EC_UDP_READ_FRMSIZE (1024 * 16) //UDP批量接收每帧缓冲大小
+#else
+#define EC_UDP_READ_FRMSIZE (1024 * 64) //UDP批量接收每帧缓冲大小
+#endif
+#endif
+
+#ifndef EC_AIO_SNDIOV_NUM
+#define EC_AIO_SNDIOV_NUM 64 // sendbuf每次sendmsg的最大块数
+#endif
+#if defined(IOV_MAX) && (EC_AIO_SNDIOV_NUM > IOV_MAX)
+#error "EC_AIO_SNDIOV_NUM must not be greater than IOV_MAX"
+#endif
+
+#ifndef EC_AIO_ZEROCOPY_MINSIZE
+#define EC_AIO_ZEROCOPY_MINSIZE (1024 * 16) // 引用块连续数据达到此长度时使用MSG_ZEROCOPY发送
+#endif
+
+#ifndef EC_AIO_ZEROCOPY_LINGER
+#define EC_AIO_ZEROCOPY_LINGER (120 * 1000) // 关闭连接时内核还未完成的MSG_ZEROCOPY发送, 引用保留的毫秒数(关闭后内核可能还在发送或重传)
+#endif
+
+#ifndef EC_AIO_ACCEPT_ONCE
+#define EC_AIO_ACCEPT_ONCE 64 // 每次监听事件最多accept的连接数,剩余的连接由下次epoll_wait继续处理
+#endif
+
+#ifndef EC_AIO_EPOLLET
+#define EC_AIO_EPOLLET 0 // 1:TCP连接使用边沿触发(EPOLLET), 只注册一次, 不再EPOLL_CTL_MOD
+#endif
+#ifndef EC_AIO_ET_IO_ONCE
+#define EC_AIO_ET_IO_ONCE 16 // EPOLLET模式每个事件最多读写次数,超过后放入待处理列表,用于连接间均衡
+#endif
+
+#define EC_AIO_ET_PENDING 0x01 // 在待处理列表中
+#define EC_AIO_ET_RDBLOCK 0x02 // 接收被流控或均衡中断,系统缓冲中可能还有数据
+#define EC_AIO_ET_WRBLOCK 0x04 // 系统发送缓冲满,等待EPOLLOUT
+#define EC_AIO_ET_RDHUP   0x08 // 对端已关闭写
 namespace ec {
 	namespace aio {
 		using NETIO = netio_linux;
+
+		/**
+		 * @brief 截短iov使总长度不超过zmax, 用于发送限速
+		 * @return 截短后的iov数
+		*/
+		inline int iovtrim(struct iovec* iov, int niov, size_t* pzlen, size_t zmax)
+		{
+			if (*pzlen <= zmax)
+				return niov;
+			size_t z = 0;
+			int i = 0;
+			while (i < niov - 1 && z + iov[i].iov_len < zmax)
+				z += iov[i++].iov_len;
+			iov[i].iov_len = zmax - z;
+			*pzlen = zmax;
+			return i + 1;
+		}
+
 		class serverepoll_
 		{
 		protected:
 			ec::ilog* _plog;
 
 			int _fdepoll;
+			int _fdwakeup; // eventfd kfd, 跨线程唤醒
+			std::atomic_int _sysfdwakeup; // eventfd 系统fd
 			NETIO _net;
+			int64_t _ustwaitend = 0; // 最近一次epoll_wait返回的ustime_mono, 用于统计事件处理耗时
+#if EC_AIO_PROFILE
+			t_aioprofile _prof;
+#endif
 
 		private:
+#if EC_AIO_EPOLLET
+			ec::vector<int> _etpendings; // EPOLLET模式待处理的fd
+#endif
 			int _lastwaiterr;
+			int _acceptonce; // 每次监听事件最多accept的连接数
+			int _numaccepted; // 未输出日志的accept成功数
+			int _numaccepterr; // 未输出日志的accept失败数
+			int _lastaccepterr; // 最后一次accept失败的errno
+			int64_t _lastacceptlog; // 上次输出accept汇总日志的时间，单位GMT毫秒
+			struct t_zclinger_ {
+				int64_t _msexpire; // mstime_mono
+				ec::refbuf* _pref;
+			};
+			ec::queue<t_zclinger_> _zclinger; // 已关闭连接的MSG_ZEROCOPY引用, 按到期时间先后排列
 			struct epoll_event _fdevts[EC_AIO_EVTS];
 		protected:
 			char _recvtmp[EC_AIO_READONCE_SIZE];
@@ -77,7 +167,7 @@ namespace ec {
 			/**
 			 * @brief received data
 			 * @param kfd keyfd
-			 * @param pdata Received data
+			 * @param pdata Received data, nullptr表示size字节已直接读入会话的_rbuf(EC_AIO_RECV_INPLACE)
 			 * @param size  Received data size
 			 * @return 0:OK; -1:error
 			*/
@@ -96,6 +186,21 @@ namespace ec {
 				return 0;
 			}
 
+			/**
+			 * @brief received UDP data batch, 一次recvmmsg收到的多帧, 默认逐帧调用onReceivedFrom
+			 * @param kfd keyfd
+			 * @param pfrms frames
+			 * @param numfrms number of frames
+			 * @return 0:OK; -1:error
+			*/
+			virtual int onReceivedFromBatch(int kfd, const udp_rfrm_* pfrms, int numfrms) {
+				for (auto i = 0; i < numfrms; i++) {
+					if (onReceivedFrom(kfd, pfrms[i]._pdata, pfrms[i]._size, pfrms[i]._paddr, pfrms[i]._addrlen) < 0)
+						return -1;
+				}
+				return 0;
+			}
+
 			/**
 			 * @brief TCP Accept
 			 * @param kfd keyfd
@@ -114,6 +219,14 @@ namespace ec {
 				return EC_AIO_READONCE_SIZE;
 			};
 
+			/**
+			 * @brief 可发送字节数, 用于发送限速
+			 * @return >0 本次最多发送的字节数; 0: 暂停发送
+			*/
+			virtual size_t sizeCanSend(psession pss) {
+				return SIZE_MAX;
+			};
+
 			/**
 			* @brief TCP asyn connect out success
 			* @param kfd keyfd
@@ -132,6 +245,11 @@ namespace ec {
 			virtual void onSendtoFailed(int kfd, const struct sockaddr* paddr, int addrlen, const void* pdata, size_t datasize, int errcode) {};
 			virtual void onSendCompleted(int kfd, size_t size) {};
 			virtual void onSendBufSizeChanged(int kfd, size_t sendbufsize, int protocol) {};
+
+			/**
+			 * @brief 被其他线程wakeup()唤醒后在本线程调用
+			*/
+			virtual void onWakeup() {};
 		protected:
 			inline int setsendbuf(int fd, int n)
 			{
@@ -162,11 +280,23 @@ namespace ec {
 				return 0;
 			}
 
+			/**
+			 * @brief TCP连接注册的epoll事件
+			*/
+			static inline uint32_t tcpevents_()
+			{
+#if EC_AIO_EPOLLET
+				return EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLRDHUP | EPOLLET;
+#else
+				return EPOLLIN | EPOLLOUT | EPOLLERR;
+#endif
+			}
+
 			int epoll_add_tcpout(int kfd)
 			{
 				struct epoll_event evt;
 				memset(&evt, 0, sizeof(evt));
-				evt.events = EPOLLIN | EPOLLOUT | EPOLLERR;
+				evt.events = tcpevents_();
 				evt.data.fd = kfd;
 				int nerr = 0;
 				if (0 != (nerr = _net.epoll_ctl_(_fdepoll, EPOLL_CTL_ADD, kfd, &evt))) {
@@ -181,16 +311,55 @@ namespace ec {
 			{
 				return _net.setkeepalive(fd, bfast) >= 0;
 			}
+
+			inline bool setzerocopy(int fd)
+			{
+				return _net.setzerocopy(fd) >= 0;
+			}
 		public:
-			serverepoll_(ec::ilog* plog) : _plog(plog), _fdepoll(-1), _lastwaiterr(-100)
+			serverepoll_(ec::ilog* plog) : _plog(plog), _fdepoll(-1), _fdwakeup(-1), _sysfdwakeup(-1), _lastwaiterr(-100)
+				, _acceptonce(EC_AIO_ACCEPT_ONCE), _numaccepted(0), _numaccepterr(0), _lastaccepterr(0), _lastacceptlog(0)
 			{
 			}
-			virtual ~serverepoll_() {
 
+			/**
+			 * @brief 设置每次监听事件最多accept的连接数
+			 * @param n 连接数, <1时为1
+			*/
+			void setacceptonce(int n)
+			{
+				_acceptonce = n < 1 ? 1 : n;
+			}
+			virtual ~serverepoll_() {
+				zclingerfree_(INT64_MAX);
+				if (_udprbufs) {
+					ec::g_free(_udprbufs);
+					_udprbufs = nullptr;
+				}
 			}
 			inline void SetFdFile(const char* sfile) {
 				_net.SetFdFile(sfile);
 			}
+
+			/**
+			 * @brief 设置fd分组，多reactor时每个reactor分配的kfd不重叠, kfd % step == base, 需在open之前调用
+			*/
+			inline void setfdstep(int base, int step) {
+				_net.setfdstep(base, step);
+			}
+
+			/**
+			 * @brief 唤醒epoll_wait, 线程安全, 会在epoll线程中调用onWakeup()
+			*/
+			void wakeup()
+			{
+				int sysfd = _sysfdwakeup.load(std::memory_order_acquire);
+				if (sysfd >= 0) {
+					uint64_t u = 1;
+					if (::write(sysfd, &u, sizeof(u)) < 0 && EAGAIN != errno)
+						_plog->add(CLOG_DEFAULT_ERR, "write eventfd failed. error = %d", errno);
+				}
+			}
 			//create epoll, return 0:ok; -1:error
 			int open(const char* spre = nullptr)
 			{
@@ -202,6 +371,28 @@ namespace ec {
 					return -1;
 				}
 				_plog->add(CLOG_DEFAULT_MSG, "%sepoll_create_ success.", spre ? spre : "");
+
+				int sysfd = -1;
+				_fdwakeup = _net.eventfd_create_(&sysfd);
+				if (_fdwakeup < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "%seventfd create failed.", spre ? spre : "");
+					_net.close_(_fdepoll);
+					_fdepoll = -1;
+					return -1;
+				}
+				struct epoll_event evt;
+				memset(&evt, 0, sizeof(evt));
+				evt.events = EPOLLIN | EPOLLERR;
+				evt.data.fd = _fdwakeup;
+				if (_net.epoll_ctl_(_fdepoll, EPOLL_CTL_ADD, _fdwakeup, &evt)) {
+					_plog->add(CLOG_DEFAULT_ERR, "%seventfd EPOLL_CTL_ADD failed.", spre ? spre : "");
+					_net.close_(_fdwakeup);
+					_fdwakeup = -1;
+					_net.close_(_fdepoll);
+					_fdepoll = -1;
+					return -1;
+				}
+				_sysfdwakeup.store(sysfd, std::memory_order_release);
 				return 0;
 			}
 
@@ -212,6 +403,8 @@ namespace ec {
 			*/
 			void close()
 			{
+				_sysfdwakeup.store(-1, std::memory_order_release);
+				_fdwakeup = -1;
 				ec::vector<int> fds;
 				fds.reserve(1024);
 				_net.getall(fds);
@@ -234,9 +427,10 @@ namespace ec {
 			 * @brief tcp listen
 			 * @param port port
 			 * @param sip  ipv4 or ipv6, nullptr or empty is ipv4 0.0.0.0
+			 * @param reuseport 1:SO_REUSEPORT, 多reactor监听同一端口
 			 * @return virtual fd; -1:failed
 			*/
-			int tcplisten(uint16_t port, const char* sip = nullptr, int ipv6only = 0)
+			int tcplisten(uint16_t port, const char* sip = nullptr, int ipv6only = 0, int reuseport = 0)
 			{
 				ec::net::socketaddr netaddr;
 				if (netaddr.set(port, sip) < 0)
@@ -245,7 +439,7 @@ namespace ec {
 				struct sockaddr* paddr = netaddr.getsockaddr(&addrlen);
 				if (!paddr)
 					return -1;
-				int fdl = _net.bind_listen(paddr, addrlen, ipv6only);
+				int fdl = _net.bind_listen(paddr, addrlen, ipv6only, reuseport);
 				if (fdl < 0) {
 					_plog->add(CLOG_DEFAULT_ERR, "bind listen tcp://%s:%u failed.", netaddr.viewip(), port);
 					return -1;
@@ -266,6 +460,89 @@ namespace ec {
 				return fdl;
 			}
 
+			/**
+			 * @brief 使用已有的监听socket, 如热重启时从旧进程收到的
+			 * @param sysfd 系统fd, 成功后由本对象管理, 失败时关闭
+			 * @return virtual fd; -1:failed
+			*/
+			int tcplisten_fd(int sysfd)
+			{
+				fcntl(sysfd, F_SETFL, fcntl(sysfd, F_GETFL) | O_NONBLOCK);
+				int fdl = _net.attach_(sysfd, NETIO::fd_listen);
+				if (fdl < 0)
+					return -1;
+				struct epoll_event evt;
+				memset(&evt, 0, sizeof(evt));
+				evt.events = EPOLLIN | EPOLLERR;
+				evt.data.fd = fdl;
+				int nerr = 0;
+				if (0 != (nerr = _net.epoll_ctl_(_fdepoll, EPOLL_CTL_ADD, fdl, &evt))) {
+					_plog->add(CLOG_DEFAULT_ERR, "epoll_ctrl_ failed. error = %d", nerr);
+					_net.close_(fdl);
+					return -1;
+				}
+				return fdl;
+			}
+
+			/**
+			 * @brief 停止在监听fd上accept, 不关闭. 热重启交接后排队的连接由新进程接收
+			 * @return 0:ok; -1:error
+			*/
+			int pauselisten(int fdl)
+			{
+				if (_net.fd_listen != _net.getfdtype(fdl))
+					return -1;
+				_net.epoll_ctl_(_fdepoll, EPOLL_CTL_DEL, fdl, nullptr);
+				return 0;
+			}
+
+			/**
+			 * @brief 接入已连接的socket, 如热重启时从旧进程收到的, 和accept一样调用onAccept
+			 * @param sysfd 系统fd, 成功后由本对象管理, 失败时关闭
+			 * @param fdlisten 所属监听fd, 可为-1
+			 * @return virtual fd; -1:failed
+			*/
+			int tcpaccept_fd(int sysfd, int fdlisten)
+			{
+				fcntl(sysfd, F_SETFL, fcntl(sysfd, F_GETFL) | O_NONBLOCK);
+				int fdc = _net.attach_(sysfd, NETIO::fd_tcp);
+				if (fdc < 0)
+					return -1;
+				struct epoll_event ev;
+				memset(&ev, 0, sizeof(ev));
+				ev.events = tcpevents_();
+				ev.data.fd = fdc;
+				int nerr = 0;
+				if (0 != (nerr = _net.epoll_ctl_(_fdepoll, EPOLL_CTL_ADD, fdc, &ev))) {
+					_plog->add(CLOG_DEFAULT_ERR, "epoll_ctrl_ EPOLL_CTL_ADD failed @tcpaccept_fd. fd = %d, error = %d", fdc, nerr);
+					_net.close_(fdc);
+					return -1;
+				}
+				ec::net::socketaddr clientaddr;
+				socklen_t* paddrlen = nullptr;
+				struct sockaddr* paddr = clientaddr.getbuffer(&paddrlen);
+				uint16_t uport = 0;
+				char sip[48] = { 0 };
+				if (!getpeername(sysfd, paddr, paddrlen))
+					clientaddr.get(uport, sip, sizeof(sip));
+				onAccept(fdc, sip, uport, fdlisten);
+				return fdc;
+			}
+
+			/**
+			 * @brief 从本对象移除连接但不断开, 用于连接已交接给其他进程. 不调用onDisconnect
+			 * @return 0:ok; -1:不支持或fd不存在
+			*/
+			int detachfd(int kfd)
+			{
+				if (!_net.hasfd(kfd))
+					return -1;
+				_net.epoll_ctl_(_fdepoll, EPOLL_CTL_DEL, kfd, nullptr);
+				_net.detach_(kfd);
+				onDisconnected(kfd);
+				return 0;
+			}
+
 			int udplisten(uint16_t port, const char* sip = nullptr, int ipv6only = 0) // return udp server fd, -1 error
 			{
 				ec::net::socketaddr netaddr;
@@ -275,6 +552,10 @@ namespace ec {
 				struct sockaddr* paddr = netaddr.getsockaddr(&addrlen);
 				if (!paddr)
 					return -1;
+				if (!_udprbufs && !(_udprbufs = (char*)ec::g_malloc(EC_UDP_READ_FRMSIZE * FRMS_UDP_READ_ONCE))) {
+					_plog->add(CLOG_DEFAULT_ERR, "malloc udp receive buffer failed.");
+					return -1;
+				}
 				int fdl = _net.create_udp(paddr, addrlen, ipv6only);
 
 				if (fdl < 0) {
@@ -296,26 +577,61 @@ namespace ec {
 				return fdl;
 			}
 
-			void runtime_(int waitmsec)
+			/**
+			 * @brief 运行时
+			 * @return 处理的事件数; -1:epoll未创建或者epoll_wait错误
+			*/
+			int runtime_(int waitmsec)
 			{
 				if (-1 == _fdepoll)
-					return;
+					return -1;
 
 				int64_t curmstime = ec::mstime();
 				if (llabs(curmstime - _lastmstime) >= 4) { //4毫秒处理一次接收流控
 					dorecvflowctrl();
 					_lastmstime = curmstime;
 				}
+				if ((_numaccepted || _numaccepterr) && llabs(curmstime - _lastacceptlog) >= 1000)
+					logaccept(curmstime);
+				if (!_zclinger.empty())
+					zclingerfree_(ec::mstime_mono());
+#if EC_AIO_EPOLLET
+				if (!_etpendings.empty() && waitmsec > 4)
+					waitmsec = 4;
+#endif
 
+#if EC_AIO_PROFILE
+				int64_t ust = ec::ustime_mono(), ust1;
+#endif
 				int nret = _net.epoll_wait_(_fdepoll, _fdevts, static_cast<int>(sizeof(_fdevts) / sizeof(struct epoll_event)), waitmsec);
+				_ustwaitend = ec::ustime_mono();
 				if (nret < 0) {
 					if (_lastwaiterr != nret)
 						_plog->add(CLOG_DEFAULT_ERR, "epoll_wait_ return %d", nret);
 					_lastwaiterr = nret;
-					return;
+					return -1;
 				}
+#if EC_AIO_PROFILE
+				_prof._wait.add(_ustwaitend - ust);
+				ust = _ustwaitend;
+				for (auto i = 0; i < nret; i++) {
+					int kfd = _fdevts[i].data.fd;
+					uint32_t events = _fdevts[i].events;
+					onevent(_fdevts[i]);
+					ust1 = ec::ustime_mono();
+					_prof._event.add(ust1 - ust);
+					if (_prof.slow(ust1 - ust)) {
+						psession pss = getSession(kfd);
+						_plog->add(CLOG_DEFAULT_WRN, "slow event fd(%d) protocol %d(%s) events %08XH %lld us", kfd,
+							pss ? pss->_protocol : -1, pss ? pss->ProtocolName(pss->_protocol) : "", events, (long long)(ust1 - ust));
+					}
+					ust = ust1;
+				}
+#else
 				for (auto i = 0; i < nret; i++)
 					onevent(_fdevts[i]);
+#endif
+				return nret;
 			}
 
 			/**
@@ -394,6 +710,7 @@ namespace ec {
 					onCloseFd(kfd);
 				}
 				onDisconnect(kfd);
+				zclinger_(kfd);
 				// Since Linux 2.6.9, event can be specified as NULL when using EPOLL_CTL_DEL
 				_net.epoll_ctl_(_fdepoll, EPOLL_CTL_DEL, kfd, nullptr);
 				_net.close_(kfd);
@@ -412,34 +729,250 @@ namespace ec {
 			}
 		private:
 			int64_t _lastmstime = 0;//上次扫描可发送的时间，单位GMT毫秒
+			/**
+			 * @brief 关闭fd前读取已完成的MSG_ZEROCOPY通知, 剩余的引用移到_zclinger, 到期后释放.
+			 * 关闭后读不到完成通知, 内核可能还在用这些页发送, 不能随会话立即释放.
+			*/
+			void zclinger_(int kfd)
+			{
+				psession pss = getSession(kfd);
+				if (!pss || pss->_zcrefs.empty())
+					return;
+				onzerocopy(kfd);
+				t_zclinger_ t;
+				t._msexpire = ec::mstime_mono() + EC_AIO_ZEROCOPY_LINGER;
+				while (!pss->_zcrefs.empty()) {
+					t._pref = pss->_zcrefs.front()._pref;
+					_zclinger.push(t);
+					pss->_zcrefs.pop();
+				}
+			}
+
+			void zclingerfree_(int64_t msnow) // 释放到期的_zclinger引用
+			{
+				while (!_zclinger.empty() && _zclinger.front()._msexpire <= msnow) {
+					_zclinger.front()._pref->release();
+					_zclinger.pop();
+				}
+			}
+
+			void logaccept(int64_t curmstime) // 输出accept汇总日志
+			{
+				if (_numaccepterr)
+					_plog->add(CLOG_DEFAULT_ERR, "accept %d connections, %d failed, last error %d", _numaccepted, _numaccepterr, _lastaccepterr);
+				else
+					_plog->add(CLOG_DEFAULT_INF, "accept %d connections", _numaccepted);
+				_numaccepted = 0;
+				_numaccepterr = 0;
+				_lastacceptlog = curmstime;
+			}
+
+			void doaccept(int fdlisten) // 接受连接直到EAGAIN或达到单次上限
+			{
+				ec::net::socketaddr clientaddr;
+				socklen_t* paddrlen = nullptr;
+				struct sockaddr* paddr;
+				int fdc, nerr;
+				struct epoll_event ev;
+				for (auto i = 0; i < _acceptonce; i++) {
+					paddr = clientaddr.getbuffer(&paddrlen);
+					fdc = _net.accept_(fdlisten, paddr, paddrlen);
+					if (fdc < 0) {
+						if (EINTR == errno || ECONNABORTED == errno)
+							continue;
+						if (EAGAIN != errno && EWOULDBLOCK != errno) {
+							_numaccepterr++;
+							_lastaccepterr = errno;
+						}
+						break;
+					}
+					memset(&ev, 0, sizeof(ev));
+					ev.events = tcpevents_();
+					ev.data.fd = fdc;
+					if (0 != (nerr = _net.epoll_ctl_(_fdepoll, EPOLL_CTL_ADD, fdc, &ev))) {
+						_plog->add(CLOG_DEFAULT_ERR, "epoll_ctrl_ EPOLL_CTL_ADD failed @onconnect_in. fd = %d, error = %d", fdc, nerr);
+						_net.close_(fdc);
+						continue;
+					}
+					_numaccepted++;
+					uint16_t uport = 0;
+					char sip[48] = { 0 };
+					clientaddr.get(uport, sip, sizeof(sip));
+					_plog->add(CLOG_DEFAULT_DBG, "fd(%d) accept from %s:%u at listen fd(%d)",
+						fdc, clientaddr.viewip(), uport, fdlisten);
+					onAccept(fdc, sip, uport, fdlisten);
+				}
+			}
 			void dorecvflowctrl()//接收流控
 			{
+#if EC_AIO_EPOLLET
+				etdopending();
+#else
 				for (auto& i : _net.getmap()) {
-					if (i.fdtype != _net.fd_listen && i.fdtype != _net.fd_epoll && i.fdtype != _net.fd_udp) {
+					if (i.fdtype != _net.fd_listen && i.fdtype != _net.fd_epoll && i.fdtype != _net.fd_udp && i.fdtype != _net.fd_event) {
 						triger_evt(getSession(i.kfd));
 					}
 				}
+#endif
 			}
 		protected:
 			void triger_evt(psession pss)
 			{
 				if (!pss)
 					return;
+#if EC_AIO_EPOLLET
+				if (etcanprogress(pss))
+					etpending(pss);
+#else
 				struct epoll_event evtmod;
 				memset(&evtmod, 0, sizeof(evtmod));
 				evtmod.events = EPOLLERR;
 
 				if (sizeCanRecv(pss) > 0 && !pss->_readpause)
 					evtmod.events |= EPOLLIN;
-				if (!pss->_sndbuf.empty() || pss->_status == EC_AIO_FD_CONNECTING || pss->hasSendJob())
+				if (pss->_status == EC_AIO_FD_CONNECTING
+					|| ((!pss->_sndbuf.empty() || pss->hasSendJob()) && sizeCanSend(pss) > 0))
 					evtmod.events |= EPOLLOUT;
+				if (evtmod.events == pss->_epollevents)
+					return;
 				evtmod.data.fd = pss->_fd;
 
 				int nerr = 0;
 				if (0 != (nerr = _net.epoll_ctl_(_fdepoll, EPOLL_CTL_MOD, pss->_fd, &evtmod)))
 					_plog->add(CLOG_DEFAULT_ERR, "epoll_ctrl_ EPOLL_CTL_MOD failed @onevent. fd = %d,  error = %d", pss->_fd, nerr);
+				else
+					pss->_epollevents = evtmod.events;
+#endif
+			}
+#if EC_AIO_EPOLLET
+			/**
+			 * @brief EPOLLET模式下不会再有事件通知,但还可以继续读写
+			*/
+			bool etcanprogress(psession pss)
+			{
+				if ((pss->_etflags & EC_AIO_ET_RDBLOCK) && !pss->_readpause && sizeCanRecv(pss) > 0)
+					return true;
+				if (!(pss->_etflags & EC_AIO_ET_WRBLOCK) && pss->_status != EC_AIO_FD_CONNECTING
+					&& (!pss->_sndbuf.empty() || pss->hasSendJob()) && sizeCanSend(pss) > 0)
+					return true;
+				return false;
+			}
+
+			void etpending(psession pss)
+			{
+				if (pss->_etflags & EC_AIO_ET_PENDING)
+					return;
+				pss->_etflags |= EC_AIO_ET_PENDING;
+				_etpendings.push_back(pss->_fd);
+			}
+
+			/**
+			 * @brief 处理待处理列表, 流控恢复后继续读, 发送缓冲未满时继续写
+			*/
+			void etdopending()
+			{
+				if (_etpendings.empty())
+					return;
+				ec::vector<int> fds;
+				fds.swap(_etpendings);
+				psession pss;
+				for (auto& kfd : fds) {
+					if (nullptr == (pss = getSession(kfd)))
+						continue;
+					pss->_etflags &= ~EC_AIO_ET_PENDING;
+					if ((pss->_etflags & EC_AIO_ET_RDBLOCK) && etread(kfd) < 0)
+						continue;
+					if (nullptr == (pss = getSession(kfd)))
+						continue;
+					if (!(pss->_etflags & EC_AIO_ET_WRBLOCK) && pss->_status != EC_AIO_FD_CONNECTING
+						&& (!pss->_sndbuf.empty() || pss->hasSendJob()) && onepollout(kfd) < 0)
+						continue;
+					sendtrigger(kfd);
+				}
+			}
+
+			/**
+			 * @brief EPOLLET模式读, 直到EAGAIN, 被流控或者超过EC_AIO_ET_IO_ONCE次时放入待处理列表
+			 * @return 0:ok; -1: 连接已关闭
+			*/
+			int etread(int kfd)
+			{
+				int nr, n = 0;
+				bool bmore;
+				size_t zr;
+				psession pss;
+				const void* prcv;
+				do {
+					if (nullptr == (pss = getSession(kfd))) //onReceived中可能升级协议替换了session
+						return -1;
+					zr = pss->_readpause ? 0 : sizeCanRecv(pss);
+					if (!zr || n >= EC_AIO_ET_IO_ONCE) {
+						if (!zr)
+							_plog->add(CLOG_DEFAULT_ALL, "fd(%d) %s pause reading for task balancing.",
+								kfd, pss->ProtocolName(pss->_protocol));
+						pss->_etflags |= EC_AIO_ET_RDBLOCK;
+						etpending(pss);
+						return 0;
+					}
+					if (zr > sizeof(_recvtmp))
+						zr = sizeof(_recvtmp);
+					nr = recvsession_(pss, kfd, zr, &prcv);
+					if (nr < 0 && (EAGAIN == _net.geterrno() || EWOULDBLOCK == _net.geterrno())) {
+						pss->_etflags &= ~EC_AIO_ET_RDBLOCK;
+						return 0;
+					}
+					if (nr <= 0) {
+						if (nr)
+							_plog->add(CLOG_DEFAULT_WRN, "fd(%d) disconnected at EPOLLIN recv return %d, errno %d", kfd,
+								nr, _net.geterrno());
+						else
+							_plog->add(CLOG_DEFAULT_DBG, "fd(%d) disconnected gracefully at EPOLLIN recv return 0", kfd);
+						closefd(kfd, 102);//network sropped
+						return -1;
+					}
+#ifdef _DEBUG
+					_plog->add(CLOG_DEFAULT_ALL, "fd(%d) received %d bytes", kfd, nr);
+#endif
+					// 流式socket读到的少于请求的, 说明系统缓冲已读空(对端已关闭写时需读到0)
+					bmore = nr == (int)zr || (pss->_etflags & EC_AIO_ET_RDHUP);
+					if (bmore)
+						pss->_etflags |= EC_AIO_ET_RDBLOCK;
+					else
+						pss->_etflags &= ~EC_AIO_ET_RDBLOCK;
+					if (onReceived(kfd, prcv, nr) < 0) {
+						closefd(kfd, 0); //主动断开
+						return -1;
+					}
+					++n;
+				} while (bmore);
+				return 0;
+			}
+#endif
+			/**
+			 * @brief 读TCP数据, EC_AIO_RECV_INPLACE模式且会话recvinplace()时直接读入会话的_rbuf尾部
+			 * @param pbuf 输出读到的数据位置, nullptr表示已读入会话的_rbuf
+			 * @return 同recv
+			*/
+			int recvsession_(psession pss, int kfd, size_t zr, const void** pbuf)
+			{
+#if EC_AIO_RECV_INPLACE
+				if (pss->recvinplace()) {
+					void* pw = pss->_rbuf.writebuf(zr);
+					if (pw) {
+						int nr = _net.recv_(kfd, pw, zr, 0);
+						if (nr > 0)
+							pss->_rbuf.commit(nr);
+						*pbuf = nullptr;
+						return nr;
+					}
+				}
+#endif
+				*pbuf = _recvtmp;
+				return _net.recv_(kfd, _recvtmp, zr, 0);
 			}
 		private:
+			struct mmsghdr _udpsmsgs[FRMS_UDP_SEND_ONCE];
+			struct iovec _udpsiovs[FRMS_UDP_SEND_ONCE];
 			void udp_sendto(int kfd)
 			{
 				psession pss = getSession(kfd);
@@ -447,66 +980,97 @@ namespace ec {
 					return;
 				}
 				udb_buffer_* pfrms = pss->getudpsndbuffer();
-				if (!pfrms || pfrms->empty()) {
+				if (!pfrms) {
 					return;
 				}
-				int numsnd = 0, nbytes = 0;
-				do {
-					auto& frm = pfrms->front();
-					if (!frm.empty()) {
-						if (_net.sendto_(kfd, frm.data(), frm.size(), frm.getnetaddr(), frm.netaddrlen()) < 0) {
-							if (EAGAIN != errno && EWOULDBLOCK != errno && ENOBUFS != errno) {
-								onSendtoFailed(kfd, frm.getnetaddr(), frm.netaddrlen(), frm.data(), frm.size(), errno);
-								pfrms->pop();
-							}
-							if (numsnd) {
-								pss->onUdpSendCount(numsnd, nbytes);
-								onSendCompleted(kfd, nbytes);
-							}
-							return;
-						}
+				while (!pfrms->empty() && pfrms->front().empty())
+					pfrms->pop();
+				if (pfrms->empty())
+					return;
+				int numfrms = 0, nbytes = 0, ns, i;
+				memset(_udpsmsgs, 0, sizeof(_udpsmsgs));
+				for (auto& frm : *pfrms) { //一次sendmmsg最多FRMS_UDP_SEND_ONCE帧,32K字节
+					if (frm.empty() || numfrms >= FRMS_UDP_SEND_ONCE || nbytes >= 1024 * 32)
+						break;
+					_udpsiovs[numfrms].iov_base = frm.data();
+					_udpsiovs[numfrms].iov_len = frm.size();
+					_udpsmsgs[numfrms].msg_hdr.msg_iov = &_udpsiovs[numfrms];
+					_udpsmsgs[numfrms].msg_hdr.msg_iovlen = 1;
+					_udpsmsgs[numfrms].msg_hdr.msg_name = (void*)frm.getnetaddr();
+					_udpsmsgs[numfrms].msg_hdr.msg_namelen = (socklen_t)frm.netaddrlen();
+					nbytes += (int)frm.size();
+					++numfrms;
+				}
+				ns = _net.sendmmsg_(kfd, _udpsmsgs, numfrms);
+				if (ns < 0) {
+					if (EAGAIN != errno && EWOULDBLOCK != errno && ENOBUFS != errno) {
+						auto& frm = pfrms->front();
+						onSendtoFailed(kfd, frm.getnetaddr(), frm.netaddrlen(), frm.data(), frm.size(), errno);
+						pfrms->pop();
+					}
+					return;
+				}
+				nbytes = 0;
+				for (i = 0; i < ns; i++) {
 #ifdef _DEBUG
-						if (_plog->getlevel() >= CLOG_DEFAULT_ALL) {
-							ec::net::socketaddr peeraddr;
-							peeraddr.set(frm.getnetaddr(), frm.netaddrlen());
-							_plog->add(CLOG_DEFAULT_ALL, "fd(%d) sento %s:%u %zu bytes.", kfd,
-								peeraddr.viewip(), peeraddr.port(), frm.size());
-						}
-#endif
-						nbytes += (int)frm.size();
+					if (_plog->getlevel() >= CLOG_DEFAULT_ALL) {
+						auto& frm = pfrms->front();
+						ec::net::socketaddr peeraddr;
+						peeraddr.set(frm.getnetaddr(), frm.netaddrlen());
+						_plog->add(CLOG_DEFAULT_ALL, "fd(%d) sento %s:%u %zu bytes.", kfd,
+							peeraddr.viewip(), peeraddr.port(), frm.size());
 					}
+#endif
+					nbytes += (int)pfrms->front().size();
 					pfrms->pop();
-					numsnd++;
-				} while (!pfrms->empty() && numsnd < FRMS_UDP_SEND_ONCE && nbytes < 1024 * 32);
-				pss->onUdpSendCount(numsnd, nbytes);
-				onSendCompleted(kfd, nbytes);
+				}
+				if (ns) {
+					pss->onUdpSendCount(ns, nbytes);
+					onSendCompleted(kfd, nbytes);
+				}
 			}
 
-			char udpbuf_[1024 * 64] = { 0 };
+			char* _udprbufs = nullptr; // FRMS_UDP_READ_ONCE * EC_UDP_READ_FRMSIZE, udplisten时分配
+			struct mmsghdr _udprmsgs[FRMS_UDP_READ_ONCE];
+			struct iovec _udpriovs[FRMS_UDP_READ_ONCE];
+			struct sockaddr_in6 _udpraddrs[FRMS_UDP_READ_ONCE];
+			udp_rfrm_ _udprfrms[FRMS_UDP_READ_ONCE];
 			void onudpevent(struct epoll_event& evt)
 			{
-				if (evt.events & EPOLLIN) {
-					int nr = -1, ndo = FRMS_UDP_READ_ONCE;
-					socklen_t* paddrlen = nullptr;
-					ec::net::socketaddr addr;
-					struct sockaddr* paddr = addr.getbuffer(&paddrlen);
-					do {
-						nr = _net.recvfrom_(evt.data.fd, udpbuf_, (int)sizeof(udpbuf_), 0, paddr, paddrlen);
-						if (nr > 0) {
+				if ((evt.events & EPOLLIN) && _udprbufs) {
+					int nr, i;
+					memset(_udprmsgs, 0, sizeof(_udprmsgs));
+					for (i = 0; i < FRMS_UDP_READ_ONCE; i++) {
+						_udpriovs[i].iov_base = _udprbufs + i * EC_UDP_READ_FRMSIZE;
+						_udpriovs[i].iov_len = EC_UDP_READ_FRMSIZE;
+						_udprmsgs[i].msg_hdr.msg_iov = &_udpriovs[i];
+						_udprmsgs[i].msg_hdr.msg_iovlen = 1;
+						_udprmsgs[i].msg_hdr.msg_name = &_udpraddrs[i];
+						_udprmsgs[i].msg_hdr.msg_namelen = sizeof(_udpraddrs[i]);
+					}
+					nr = _net.recvmmsg_(evt.data.fd, _udprmsgs, FRMS_UDP_READ_ONCE);
+					if (nr > 0) {
+						for (i = 0; i < nr; i++) {
+							_udprfrms[i]._pdata = _udpriovs[i].iov_base;
+							_udprfrms[i]._size = _udprmsgs[i].msg_len;
+							_udprfrms[i]._paddr = (const struct sockaddr*)&_udpraddrs[i];
+							_udprfrms[i]._addrlen = (int)_udprmsgs[i].msg_hdr.msg_namelen;
 #ifdef _DEBUG
 							if (_plog->getlevel() >= CLOG_DEFAULT_ALL) {
-								_plog->add(CLOG_DEFAULT_ALL, "fd(%d) recvfrom %s:%u %d bytes.", evt.data.fd,
-									addr.viewip(), addr.port(), nr);
+								ec::net::socketaddr addr;
+								addr.set(_udprfrms[i]._paddr, _udprfrms[i]._addrlen);
+								_plog->add(CLOG_DEFAULT_ALL, "fd(%d) recvfrom %s:%u %u bytes.", evt.data.fd,
+									addr.viewip(), addr.port(), _udprmsgs[i].msg_len);
 							}
 #endif
-							if (onReceivedFrom(evt.data.fd, udpbuf_, nr, paddr, *paddrlen) < 0)
-								break;
+							if (_udprmsgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+								_plog->add(CLOG_DEFAULT_WRN, "fd(%d) recvfrom frame truncated to %d bytes.", evt.data.fd, EC_UDP_READ_FRMSIZE);
 						}
-						else if (nr < 0 && EAGAIN != errno && EWOULDBLOCK != errno) {
-							_plog->add(CLOG_DEFAULT_ERR, "fd(%d) recvfrom failed. error %d", evt.data.fd, errno);
-						}
-						--ndo;
-					} while (nr > 0 && ndo > 0);
+						onReceivedFromBatch(evt.data.fd, _udprfrms, nr);
+					}
+					else if (nr < 0 && EAGAIN != errno && EWOULDBLOCK != errno) {
+						_plog->add(CLOG_DEFAULT_ERR, "fd(%d) recvfrom failed. error %d", evt.data.fd, errno);
+					}
 				}
 				if (evt.events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
 					_plog->add(CLOG_DEFAULT_ERR, "udp fd(%d)  error events %08XH", evt.data.fd, evt.events);
@@ -519,6 +1083,15 @@ namespace ec {
 			void onevent(struct epoll_event& evt)
 			{
 				int nfdtype = _net.getfdtype(evt.data.fd);
+				if (nfdtype == _net.fd_event) {
+					uint64_t u = 0;
+					int sysfd = _net.getsysfd(evt.data.fd);
+					while (::read(sysfd, &u, sizeof(u)) > 0);
+					onWakeup();
+					return;
+				}
+				if ((evt.events & EPOLLERR) && onzerocopy(evt.data.fd)) // MSG_ZEROCOPY完成通知
+					evt.events &= ~EPOLLERR;
 				if (nfdtype == _net.fd_udp) {
 					onudpevent(evt);
 					udp_trigger(evt.data.fd);
@@ -528,33 +1101,21 @@ namespace ec {
 #ifdef _DEBUG
 					_plog->add(CLOG_DEFAULT_ALL, "listen fd(%d)  EPOLLIN, events %08XH", evt.data.fd, evt.events);
 #endif
-					ec::net::socketaddr clientaddr;
-					socklen_t* paddrlen = nullptr;
-					struct sockaddr* paddr = clientaddr.getbuffer(&paddrlen);
-					int fdc = _net.accept_(evt.data.fd, paddr, paddrlen);
-					if (fdc >= 0) {
-						int nerr = 0;
-						struct epoll_event ev;
-						memset(&ev, 0, sizeof(ev));
-						ev.events = EPOLLIN | EPOLLOUT | EPOLLERR;
-						ev.data.fd = fdc;
-						if (0 != (nerr = _net.epoll_ctl_(_fdepoll, EPOLL_CTL_ADD, fdc, &ev))) {
-							_plog->add(CLOG_DEFAULT_ERR, "epoll_ctrl_ EPOLL_CTL_ADD failed @onconnect_in. fd = %d, error = %d", fdc, nerr);
-							_net.close_(fdc);
-						}
-						else {
-							uint16_t uport = 0;
-							char sip[48] = { 0 };
-							clientaddr.get(uport, sip, sizeof(sip));
-							_plog->add(CLOG_DEFAULT_INF, "fd(%d) accept from %s:%u at listen fd(%d)",
-								fdc, clientaddr.viewip(), uport, evt.data.fd);
-							onAccept(fdc, sip, uport, evt.data.fd);
-						}
-					}
-					else
-						_plog->add(CLOG_DEFAULT_ERR, "accept failed. listen fd = %d", evt.data.fd);
+					doaccept(evt.data.fd);
 					return;
 				}
+#if EC_AIO_EPOLLET
+				if (evt.events & (EPOLLIN | EPOLLRDHUP)) {
+					psession pss = getSession(evt.data.fd);
+					if (pss) {
+						if (evt.events & EPOLLRDHUP)
+							pss->_etflags |= EC_AIO_ET_RDHUP | EC_AIO_ET_RDBLOCK;
+						if (etread(evt.data.fd) < 0)
+							return;
+					}
+				}
+				if (evt.events & (EPOLLERR | EPOLLHUP)) { // EPOLLRDHUP在etread读到0后断开
+#else
 				if (evt.events & EPOLLIN) {
 					int nr = -1;
 					psession pss = getSession(evt.data.fd);
@@ -563,7 +1124,8 @@ namespace ec {
 						if (zr > 0) {
 							if (zr > sizeof(_recvtmp))
 								zr = sizeof(_recvtmp);
-							nr = _net.recv_(evt.data.fd, _recvtmp, zr, 0);
+							const void* prcv;
+							nr = recvsession_(pss, evt.data.fd, zr, &prcv);
 							if (!nr || (nr < 0 && EAGAIN != _net.geterrno() && EWOULDBLOCK != _net.geterrno())) {
 								if (nr) {
 									_plog->add(CLOG_DEFAULT_WRN, "fd(%d) disconnected at EPOLLIN recv return %d, errno %d", evt.data.fd,
@@ -578,7 +1140,7 @@ namespace ec {
 #ifdef _DEBUG
 							_plog->add(CLOG_DEFAULT_ALL, "fd(%d) received %d bytes", evt.data.fd, nr);
 #endif
-							if (nr > 0 && onReceived(evt.data.fd, _recvtmp, nr) < 0) {
+							if (nr > 0 && onReceived(evt.data.fd, prcv, nr) < 0) {
 								closefd(evt.data.fd, 0); //主动断开
 								return;
 							}
@@ -590,6 +1152,7 @@ namespace ec {
 					}
 				}
 				if (evt.events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+#endif
 					_plog->add(CLOG_DEFAULT_DBG, "fd(%d)  error events %08XH %s %s %s %s %s", evt.data.fd, evt.events,
 						(evt.events & EPOLLERR)? "EPOLLERR" :"", (evt.events & EPOLLHUP) ? "EPOLLHUP" : "",
 						(evt.events & EPOLLRDHUP) ? "EPOLLRDHUP" : "", (evt.events & EPOLLIN) ? "EPOLLIN" : "",
@@ -600,6 +1163,11 @@ namespace ec {
 				if (evt.events & EPOLLOUT) {
 #ifdef _DEBUG
 					_plog->add(CLOG_DEFAULT_ALL, "fd(%d)  EPOLLOUT, events %08XH", evt.data.fd, evt.events);
+#endif
+#if EC_AIO_EPOLLET
+					psession pss = getSession(evt.data.fd);
+					if (pss)
+						pss->_etflags &= ~EC_AIO_ET_WRBLOCK;
 #endif
 					if (onepollout(evt.data.fd) < 0)
 						return;
@@ -628,6 +1196,10 @@ namespace ec {
 						return 0;
 					}
 				}
+#if EC_AIO_EPOLLET
+				int n = 0;
+				do { // 边沿触发, 发送到系统缓冲满或者应用缓冲空
+#endif
 				if (sendbuf(pss) < 0) {
 					closefd(kfd, 102);//network dropped
 					return -1;
@@ -641,9 +1213,61 @@ namespace ec {
 						return -1;
 					}
 				}
+#if EC_AIO_EPOLLET
+				} while (!(pss->_etflags & EC_AIO_ET_WRBLOCK) && !pss->_sndbuf.empty() && ++n < EC_AIO_ET_IO_ONCE);
+#endif
 				return 0;
 			}
 
+			/**
+			 * @brief MSG_ZEROCOPY发送成功后持有引用, 直到内核完成通知
+			*/
+			void zchold(psession pss, const struct iovec* iov, ec::refbuf** prefs, int niov, int ns)
+			{
+				session::zcref_ zr;
+				size_t zt = 0;
+				zr._seq = pss->_zcseq++;
+				for (auto i = 0; i < niov && zt < (size_t)ns; i++) {
+					zr._pref = prefs[i]->addref();
+					pss->_zcrefs.push(zr);
+					zt += iov[i].iov_len;
+				}
+			}
+
+			/**
+			 * @brief EPOLLERR时读取socket错误队列中的MSG_ZEROCOPY完成通知, 释放内核已完成的引用
+			 * @return true: 连接没有错误, 只是完成通知
+			*/
+			bool onzerocopy(int kfd)
+			{
+				psession pss = getSession(kfd);
+				if (!pss || pss->_zcflag <= 0)
+					return false;
+				char control[128];
+				struct msghdr msg;
+				struct cmsghdr* cm;
+				struct sock_extended_err* perr;
+				for (;;) {
+					memset(&msg, 0, sizeof(msg));
+					msg.msg_control = control;
+					msg.msg_controllen = sizeof(control);
+					if (_net.recverrq_(kfd, &msg) < 0)
+						break;
+					for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+						if (!((SOL_IP == cm->cmsg_level && IP_RECVERR == cm->cmsg_type)
+							|| (SOL_IPV6 == cm->cmsg_level && IPV6_RECVERR == cm->cmsg_type)))
+							continue;
+						perr = (struct sock_extended_err*)CMSG_DATA(cm);
+						if (SO_EE_ORIGIN_ZEROCOPY == perr->ee_origin && !perr->ee_errno)
+							pss->zcdone(perr->ee_data); // [ee_info, ee_data]
+					}
+				}
+				int serr = 0;
+				socklen_t serrlen = sizeof(serr);
+				getsockopt(_net.getsysfd(kfd), SOL_SOCKET, SO_ERROR, (void*)&serr, &serrlen);
+				return !serr;
+			}
+
 			/**
 			 * @brief 发送,直到系统缓冲满或者发送应用缓冲发送完成。
 			 * @param pss
@@ -657,12 +1281,24 @@ namespace ec {
 				if (pdata && size)
 					pss->_sndbuf.append((const uint8_t*)pdata, size);
 
-				const void* pd = nullptr;
-				size_t zlen = 0;
-
-				pd = pss->_sndbuf.get(zlen);
-				while (pd && zlen) {
-					ns = _net.send_(fd, pd, (int)(zlen), MSG_DONTWAIT | MSG_NOSIGNAL);
+				struct iovec iov[EC_AIO_SNDIOV_NUM];
+				ec::refbuf* prefs[EC_AIO_SNDIOV_NUM];
+				size_t zlen = 0, zcan = sizeCanSend(pss); //本次最多发送字节数,限速时小于缓冲
+				int niov, blkref, flags;
+				for (;;) {
+					blkref = pss->_zcflag > 0 ? pss->_sndbuf.headref() : -1; //零拷贝时引用块和普通块分开发送
+					niov = pss->_sndbuf.getiov(iov, EC_AIO_SNDIOV_NUM, &zlen, blkref, prefs);
+					if (niov <= 0 || !zlen || !zcan)
+						break;
+					niov = iovtrim(iov, niov, &zlen, zcan);
+					flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+					if (1 == blkref && zlen >= EC_AIO_ZEROCOPY_MINSIZE && !pss->_time_error) // 即将断开的会话拷贝发送
+						flags |= MSG_ZEROCOPY;
+					ns = _net.sendv_(fd, iov, niov, flags);
+					if (ns < 0 && (flags & MSG_ZEROCOPY) && ENOBUFS == _net.geterrno()) { //超过optmem限制,拷贝发送
+						flags &= ~MSG_ZEROCOPY;
+						ns = _net.sendv_(fd, iov, niov, flags);
+					}
 #ifdef _DEBUG
 					_plog->add(CLOG_DEFAULT_ALL, "sendbuf fd(%d) size %d", fd, ns);
 #endif
@@ -670,17 +1306,27 @@ namespace ec {
 						int nerr = _net.geterrno();
 						if (nerr != EAGAIN)
 							_plog->add(CLOG_DEFAULT_ERR, "fd(%d) sendbuf syserr %d", fd, nerr);
-						else
+						else {
 							ns = 0;
+#if EC_AIO_EPOLLET
+							pss->_etflags |= EC_AIO_ET_WRBLOCK;
+#endif
+						}
 						break;
 					}
 					else if (!ns)
 						break;
+					if (flags & MSG_ZEROCOPY)
+						zchold(pss, iov, prefs, niov, ns);
 					nsnd += ns;
+					zcan -= ns;
 					pss->_sndbuf.freesize(ns);
-					if (ns < (int)(zlen))
+					if (ns < (int)(zlen)) {
+#if EC_AIO_EPOLLET
+						pss->_etflags |= EC_AIO_ET_WRBLOCK;
+#endif
 						break;
-					pd = pss->_sndbuf.get(zlen);
+					}
 				}
 				if (nsnd) {
 					pss->_allsend += nsnd;
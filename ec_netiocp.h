@@ -3,6 +3,8 @@
 * base net server class use IOCP for windows
 * @author jiangyong
 * @update
+	2026-10-16 EC_AIO_PROFILE时统计GetQueuedCompletionStatus等待耗时
+	2026-10-16 增加_ustwaitend, 用于统计完成消息处理耗时
 	2024-12-30 优化udp发送
 	2024.11.9 support no ec_alloctor
 	2024-7-28 修复oniocp_accept未判断nextfd返回-1满链接场景
@@ -152,6 +154,10 @@ namespace ec {
 			}
 		protected:
 			ec::ilog* _plog;
+			int64_t _ustwaitend = 0; // 最近一次GetQueuedCompletionStatus返回的ustime_mono, 用于统计完成消息处理耗时
+#if EC_AIO_PROFILE
+			t_aioprofile _prof;
+#endif
 
 			HANDLE _hiocp;
 			ec::hashmap<int, t_fd, keq_fd> _mapfd;
@@ -526,6 +532,9 @@ namespace ec {
 				DWORD			dwBytes = 0;
 				LPOVERLAPPED	pOverlapped = nullptr;
 				ULONG_PTR		uKey = 0; // fdl, 虚拟fd， CreateIoCompletionPort中的 CompletionKey
+#if EC_AIO_PROFILE
+				int64_t ust = ec::ustime_mono();
+#endif
 
 				BOOL rc = GetQueuedCompletionStatus(
 					_hiocp,
@@ -533,6 +542,10 @@ namespace ec {
 					&uKey,
 					(LPOVERLAPPED*)&pOverlapped,
 					waitmsec);
+				_ustwaitend = ec::ustime_mono();
+#if EC_AIO_PROFILE
+				_prof._wait.add(_ustwaitend - ust);
+#endif
 
 				if (!rc) { //失败的完成消息
 					t_overlap* pol = (t_overlap*)pOverlapped;
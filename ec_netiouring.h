@@ -0,0 +1,1394 @@
+﻿/*
+* @file ec_netiouring.h
+* base net server class use io_uring for linux
+*
+* 与serverepoll_接口相同的io_uring后端, 定义EC_AIOSRV_IOURING为1时netserver使用本类, 应用层不需要修改.
+* 直接使用系统调用, 不依赖liburing, 需要Linux 6.0以上(multishot recv, provided buffer ring).
+* TCP: multishot accept; multishot recv从注册的接收缓冲环中取缓冲;
+*      发送使用MSG_DONTWAIT的sendmsg, 随下一次io_uring_enter批量提交并在提交时执行, 系统缓冲满时挂POLLOUT后继续.
+* UDP和唤醒eventfd使用multishot poll, 收发和epoll版相同(recvmmsg/sendmmsg).
+*
+* @author jiangyong
+* @update
+  2026-10-16 eventfd创建或POLL_ADD失败时open()返回-1并关闭io_uring, 避免wakeup()失效
+  2026-10-16 增加热重启交接用的tcplisten_fd(),tcpaccept_fd(),pauselisten(); 不支持交接会话(detachfd返回-1)
+  2026-10-16 EC_AIO_PROFILE时统计io_uring_enter等待和每个完成项的处理耗时, 慢完成项记录日志
+  2026-10-16 增加_ustwaitend, 用于统计完成项处理耗时
+  2026-10-16 增加发送限速sizeCanSend()
+  2026-10-16 runtime_返回处理的完成项数
+  2026-10-16 first version
+
+eclib 4.0 Copyright (c) 2017-2024, kipway
+source repository : https://github.com/kipway
+
+Licensed under the Apache License, Version 2.0 (the "License");
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+*/
+#pragma once
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <time.h>
+#include <linux/io_uring.h>
+#include "ec_netepoll.h" // NETIO, UDP和发送相关的宏定义
+
+#ifndef EC_URING_ENTRIES
+#define EC_URING_ENTRIES 1024 // 提交队列大小, 完成队列为其4倍
+#endif
+#ifndef EC_URING_RBUF_NUM
+#define EC_URING_RBUF_NUM 256 // 接收缓冲环的块数, 2的幂
+#endif
+#ifndef EC_URING_RBUF_SIZE
+#define EC_URING_RBUF_SIZE EC_AIO_READONCE_SIZE // 接收缓冲环每块大小
+#endif
+#ifndef EC_URING_SNDCTX
+#define EC_URING_SNDCTX 128 // 一次提交中最多的sendmsg数, 超过时先提交
+#endif
+#ifndef EC_URING_UDP_READS
+#define EC_URING_UDP_READS 16 // UDP每次可读通知最多recvmmsg次数
+#endif
+
+#if (EC_URING_RBUF_NUM & (EC_URING_RBUF_NUM - 1)) || EC_URING_RBUF_NUM > 32768
+#error "EC_URING_RBUF_NUM must be a power of 2 and not greater than 32768"
+#endif
+
+// t_fd::pollevents中的io_uring请求状态
+#define EC_URING_F_RECV    0x01 // multishot recv/accept/poll已提交
+#define EC_URING_F_SEND    0x02 // sendmsg未完成
+#define EC_URING_F_POLLOUT 0x04 // POLLOUT未完成
+#define EC_URING_F_RDPAUSE 0x08 // 接收流控中
+#define EC_URING_F_CANCEL  0x10 // 流控已取消multishot recv
+#define EC_URING_F_REARM   0x20 // 在重新提交列表中
+namespace ec {
+	namespace aio {
+		/**
+		 * @brief io_uring提交和完成队列, 只在一个线程中使用
+		*/
+		class uring_
+		{
+		protected:
+			int _fd;
+			unsigned _sqmask, _sqentries, _cqmask;
+			unsigned* _sqhead;
+			unsigned* _sqtail;
+			unsigned* _cqhead;
+			unsigned* _cqtail;
+			struct io_uring_sqe* _sqes;
+			struct io_uring_cqe* _cqes;
+			void* _ring;
+			size_t _ringsize, _sqesize;
+			unsigned _tail; // 本地提交队列尾, submit时写入内核
+		public:
+			uring_() : _fd(-1), _sqmask(0), _sqentries(0), _cqmask(0), _sqhead(nullptr), _sqtail(nullptr)
+				, _cqhead(nullptr), _cqtail(nullptr), _sqes(nullptr), _cqes(nullptr), _ring(nullptr)
+				, _ringsize(0), _sqesize(0), _tail(0)
+			{
+			}
+			~uring_()
+			{
+				close();
+			}
+			inline int fd() const
+			{
+				return _fd;
+			}
+
+			/**
+			 * @brief 创建io_uring并映射队列
+			 * @return 0:ok; -1:failed, errno为错误码
+			*/
+			int open(unsigned entries)
+			{
+				if (_fd >= 0)
+					return 0;
+				struct io_uring_params p;
+				memset(&p, 0, sizeof(p));
+				p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+				p.cq_entries = entries * 4;
+				_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+				if (_fd < 0 && EINVAL == errno) { // 低版本内核不支持SUBMIT_ALL, COOP_TASKRUN
+					memset(&p, 0, sizeof(p));
+					p.flags = IORING_SETUP_CQSIZE;
+					p.cq_entries = entries * 4;
+					_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+				}
+				if (_fd < 0)
+					return -1;
+				const unsigned feats = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_EXT_ARG;
+				if ((p.features & feats) != feats) {
+					close();
+					errno = ENOSYS;
+					return -1;
+				}
+				size_t sqsize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+				size_t cqsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+				_ringsize = sqsize > cqsize ? sqsize : cqsize;
+				_ring = mmap(nullptr, _ringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+				if (MAP_FAILED == _ring) {
+					_ring = nullptr;
+					close();
+					return -1;
+				}
+				_sqesize = p.sq_entries * sizeof(struct io_uring_sqe);
+				_sqes = (struct io_uring_sqe*)mmap(nullptr, _sqesize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+				if (MAP_FAILED == (void*)_sqes) {
+					_sqes = nullptr;
+					close();
+					return -1;
+				}
+				char* pr = (char*)_ring;
+				_sqhead = (unsigned*)(pr + p.sq_off.head);
+				_sqtail = (unsigned*)(pr + p.sq_off.tail);
+				_sqmask = *(unsigned*)(pr + p.sq_off.ring_mask);
+				_sqentries = *(unsigned*)(pr + p.sq_off.ring_entries);
+				unsigned* parray = (unsigned*)(pr + p.sq_off.array);
+				for (unsigned i = 0; i < _sqentries; i++)
+					parray[i] = i;
+				_cqhead = (unsigned*)(pr + p.cq_off.head);
+				_cqtail = (unsigned*)(pr + p.cq_off.tail);
+				_cqmask = *(unsigned*)(pr + p.cq_off.ring_mask);
+				_cqes = (struct io_uring_cqe*)(pr + p.cq_off.cqes);
+				_tail = *_sqtail;
+				return 0;
+			}
+
+			/**
+			 * @brief 关闭io_uring, 内核会取消所有未完成的请求
+			*/
+			void close()
+			{
+				if (_sqes)
+					munmap(_sqes, _sqesize);
+				if (_ring)
+					munmap(_ring, _ringsize);
+				_sqes = nullptr;
+				_ring = nullptr;
+				if (_fd >= 0)
+					::close(_fd);
+				_fd = -1;
+			}
+
+			inline int registerx(unsigned opcode, void* arg, unsigned nargs)
+			{
+				return (int)syscall(__NR_io_uring_register, _fd, opcode, arg, nargs);
+			}
+
+			/**
+			 * @brief 取一个清零的提交项, 队列满时先提交
+			 * @return nullptr: 提交失败队列仍满
+			*/
+			struct io_uring_sqe* getsqe()
+			{
+				if (_tail - __atomic_load_n(_sqhead, __ATOMIC_ACQUIRE) >= _sqentries) {
+					submit();
+					if (_tail - __atomic_load_n(_sqhead, __ATOMIC_ACQUIRE) >= _sqentries)
+						return nullptr;
+				}
+				struct io_uring_sqe* sqe = &_sqes[_tail & _sqmask];
+				memset(sqe, 0, sizeof(*sqe));
+				++_tail;
+				return sqe;
+			}
+
+			inline unsigned pending() const
+			{
+				return _tail - __atomic_load_n(_sqhead, __ATOMIC_ACQUIRE);
+			}
+
+			inline bool cqready() const
+			{
+				return *_cqhead != __atomic_load_n(_cqtail, __ATOMIC_ACQUIRE);
+			}
+
+			/**
+			 * @brief 提交并等待完成
+			 * @param waitmsec 等待毫秒数, <=0不等待
+			 * @return >=0:提交数; <0: -errno
+			*/
+			int enter(int waitmsec)
+			{
+				__atomic_store_n(_sqtail, _tail, __ATOMIC_RELEASE);
+				unsigned nsub = pending(), flags = IORING_ENTER_GETEVENTS;
+				struct io_uring_getevents_arg arg;
+				struct __kernel_timespec ts;
+				memset(&arg, 0, sizeof(arg));
+				if (waitmsec > 0) {
+					ts.tv_sec = waitmsec / 1000;
+					ts.tv_nsec = (waitmsec % 1000) * 1000000LL;
+					arg.ts = (uint64_t)(uintptr_t)&ts;
+					flags |= IORING_ENTER_EXT_ARG;
+				}
+				int nret = (int)syscall(__NR_io_uring_enter, _fd, nsub, waitmsec > 0 ? 1 : 0, flags,
+					waitmsec > 0 ? (void*)&arg : nullptr, waitmsec > 0 ? sizeof(arg) : 0);
+				return nret < 0 ? -errno : nret;
+			}
+
+			/**
+			 * @brief 只提交不等待
+			 * @return >=0:提交数; <0: -errno
+			*/
+			int submit()
+			{
+				__atomic_store_n(_sqtail, _tail, __ATOMIC_RELEASE);
+				unsigned nsub = pending();
+				if (!nsub)
+					return 0;
+				int nret = (int)syscall(__NR_io_uring_enter, _fd, nsub, 0, 0, nullptr, 0);
+				return nret < 0 ? -errno : nret;
+			}
+
+			/**
+			 * @brief 取出一个完成项
+			 * @return false: 完成队列空
+			*/
+			bool getcqe(struct io_uring_cqe& cqe)
+			{
+				unsigned head = *_cqhead;
+				if (head == __atomic_load_n(_cqtail, __ATOMIC_ACQUIRE))
+					return false;
+				cqe = _cqes[head & _cqmask];
+				__atomic_store_n(_cqhead, head + 1, __ATOMIC_RELEASE);
+				return true;
+			}
+		};
+
+		class serveruring_
+		{
+		protected:
+			ec::ilog* _plog;
+
+			int _fdwakeup; // eventfd kfd, 跨线程唤醒
+			std::atomic_int _sysfdwakeup; // eventfd 系统fd
+			NETIO _net;
+			uring_ _ring;
+			int64_t _ustwaitend = 0; // 最近一次io_uring_enter返回的ustime_mono, 用于统计完成项处理耗时
+#if EC_AIO_PROFILE
+			t_aioprofile _prof;
+#endif
+
+		private:
+			enum uop_ { // user_data高32位为操作, 低32位为kfd
+				uop_accept = 1,
+				uop_recv,
+				uop_send,
+				uop_pollout,
+				uop_pollin,
+				uop_cancel
+			};
+			struct sndctx_ { // sendmsg参数, 提交后即可重用(IORING_FEAT_SUBMIT_STABLE)
+				struct msghdr _msg;
+				struct iovec _iov[EC_AIO_SNDIOV_NUM];
+			};
+			sndctx_ _sndctx[EC_URING_SNDCTX];
+			int _nsndctx; // 本次提交已使用的_sndctx数
+
+			struct io_uring_buf* _bufring; // 接收缓冲环, 环尾为_bufring[0].resv(同io_uring_buf_ring::tail)
+			char* _rbufs; // EC_URING_RBUF_NUM * EC_URING_RBUF_SIZE
+			uint16_t _buftail;
+
+			ec::vector<int> _rdpaused; // 接收流控中的fd
+			ec::vector<int> _rearms; // multishot请求结束后需重新提交的fd
+			int _lastwaiterr;
+			int _acceptonce; // 兼容serverepoll_, multishot accept不使用
+			int _numaccepted; // 未输出日志的accept成功数
+			int _numaccepterr; // 未输出日志的accept失败数
+			int _lastaccepterr; // 最后一次accept失败的errno
+			int64_t _lastacceptlog; // 上次输出accept汇总日志的时间，单位GMT毫秒
+		protected:
+			/**
+			 * @brief 主动断开，用于特殊处理websocket断开发送握手信号
+			 * @param kfd
+			*/
+			virtual void onCloseFd(int kfd) = 0;
+
+			/**
+			 * @brief before disconnect call
+			 * @param kfd keyfd
+			*/
+			virtual void onDisconnect(int kfd) = 0;
+
+			/**
+			 * @brief after disconnect call
+			 * @param kfd keyfd
+			*/
+			virtual void onDisconnected(int kfd) = 0;
+
+			/**
+			 * @brief received data
+			 * @param kfd keyfd
+			 * @param pdata Received data, 指向接收缓冲环, 只在调用期间有效
+			 * @param size  Received data size
+			 * @return 0:OK; -1:error
+			*/
+			virtual int onReceived(int kfd, const void* pdata, size_t size) = 0;
+
+			/**
+			 * @brief received UDP data
+			 * @return 0:OK; -1:error
+			*/
+			virtual int onReceivedFrom(int kfd, const void* pdata, size_t size, const struct sockaddr* addrfrom, int addrlen) {
+				return 0;
+			}
+
+			/**
+			 * @brief received UDP data batch, 一次recvmmsg收到的多帧, 默认逐帧调用onReceivedFrom
+			 * @return 0:OK; -1:error
+			*/
+			virtual int onReceivedFromBatch(int kfd, const udp_rfrm_* pfrms, int numfrms) {
+				for (auto i = 0; i < numfrms; i++) {
+					if (onReceivedFrom(kfd, pfrms[i]._pdata, pfrms[i]._size, pfrms[i]._paddr, pfrms[i]._addrlen) < 0)
+						return -1;
+				}
+				return 0;
+			}
+
+			/**
+			 * @brief TCP Accept
+			 * @param kfd keyfd
+			 * @param sip peer ip
+			 * @param port peer port
+			 * @param kfd_listen keyfd of listened
+			*/
+			virtual void onAccept(int kfd, const char* sip, uint16_t port, int kfd_listen) = 0;
+
+			/**
+			 * @brief size can receive ,use for flowctrl
+			 * @return >0 size can receive;  0: pause read
+			*/
+			virtual size_t  sizeCanRecv(psession pss) {
+				return EC_AIO_READONCE_SIZE;
+			};
+
+			/**
+			 * @brief 可发送字节数, 用于发送限速
+			 * @return >0 本次最多发送的字节数; 0: 暂停发送
+			*/
+			virtual size_t sizeCanSend(psession pss) {
+				return SIZE_MAX;
+			};
+
+			/**
+			* @brief TCP asyn connect out success
+			* @param kfd keyfd
+			* @remark will call onDisconnect and onDisconnected if failed.
+			*/
+			virtual void onTcpOutConnected(int kfd) {
+			}
+
+			/**
+			 * @brief get the session of kfd
+			 * @param kfd keyfd
+			 * @return nullptr or psession
+			*/
+			virtual psession getSession(int kfd) = 0;
+
+			virtual void onSendtoFailed(int kfd, const struct sockaddr* paddr, int addrlen, const void* pdata, size_t datasize, int errcode) {};
+			virtual void onSendCompleted(int kfd, size_t size) {};
+			virtual void onSendBufSizeChanged(int kfd, size_t sendbufsize, int protocol) {};
+
+			/**
+			 * @brief 被其他线程wakeup()唤醒后在本线程调用
+			*/
+			virtual void onWakeup() {};
+		protected:
+			inline int setsendbuf(int fd, int n)
+			{
+				return _net.setsendbuf(fd, n);
+			}
+
+			inline int setrecvbuf(int fd, int n)
+			{
+				return _net.setrecvbuf(fd, n);
+			}
+
+			inline int connect_asyn(const struct sockaddr* addr, socklen_t addrlen) {
+				return _net.connect_asyn(addr, addrlen);
+			}
+
+			/**
+			 * @brief shutdown and close a kfd
+			 * @param kfd  keyfd
+			 * @return
+			*/
+			int close_(int kfd) //shutdown and close kfd
+			{
+				int ftype = _net.getfdtype(kfd);
+				if (ftype < 0)
+					return -1;
+				_plog->add(CLOG_DEFAULT_DBG, "close_ fd(%d), fdtype = %d", kfd, ftype);
+				cancelfd_(kfd);
+				_net.close_(kfd);
+				return 0;
+			}
+
+			/**
+			 * @brief 异步连接出去的fd等待连接完成, 名称和serverepoll_相同
+			*/
+			int epoll_add_tcpout(int kfd)
+			{
+				if (pollout_(kfd) < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) io_uring POLL_ADD failed.", kfd);
+					_net.close_(kfd);
+					return -1;
+				}
+				return 0;
+			}
+
+			inline bool setkeepalive(int fd, bool bfast = false)
+			{
+				return _net.setkeepalive(fd, bfast) >= 0;
+			}
+
+			inline bool setzerocopy(int fd) // sendmsg在提交时完成拷贝, 不使用MSG_ZEROCOPY
+			{
+				return false;
+			}
+		public:
+			serveruring_(ec::ilog* plog) : _plog(plog), _fdwakeup(-1), _sysfdwakeup(-1), _nsndctx(0)
+				, _bufring(nullptr), _rbufs(nullptr), _buftail(0), _lastwaiterr(0)
+				, _acceptonce(EC_AIO_ACCEPT_ONCE), _numaccepted(0), _numaccepterr(0), _lastaccepterr(0), _lastacceptlog(0)
+			{
+			}
+			virtual ~serveruring_() {
+				_ring.close();
+				freebufring_();
+				if (_udprbufs) {
+					ec::g_free(_udprbufs);
+					_udprbufs = nullptr;
+				}
+			}
+
+			/**
+			 * @brief 兼容serverepoll_, multishot accept每个连接一个完成项, 不需要限制
+			*/
+			void setacceptonce(int n)
+			{
+				_acceptonce = n < 1 ? 1 : n;
+			}
+			inline void SetFdFile(const char* sfile) {
+				_net.SetFdFile(sfile);
+			}
+
+			/**
+			 * @brief 设置fd分组，多reactor时每个reactor分配的kfd不重叠, 需在open之前调用
+			*/
+			inline void setfdstep(int base, int step) {
+				_net.setfdstep(base, step);
+			}
+
+			/**
+			 * @brief 唤醒io_uring_enter, 线程安全, 会在本线程中调用onWakeup()
+			*/
+			void wakeup()
+			{
+				int sysfd = _sysfdwakeup.load(std::memory_order_acquire);
+				if (sysfd >= 0) {
+					uint64_t u = 1;
+					if (::write(sysfd, &u, sizeof(u)) < 0 && EAGAIN != errno)
+						_plog->add(CLOG_DEFAULT_ERR, "write eventfd failed. error = %d", errno);
+				}
+			}
+
+			/**
+			 * @brief 创建io_uring和接收缓冲环
+			 * @return 0:ok; -1:error, 内核不支持时失败, 可改用serverepoll_(EC_AIOSRV_IOURING 0)
+			*/
+			int open(const char* spre = nullptr)
+			{
+				if (_ring.fd() >= 0)
+					return 0;
+				if (_ring.open(EC_URING_ENTRIES) < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "%sio_uring_setup failed. error = %d", spre ? spre : "", errno);
+					return -1;
+				}
+				if (openbufring_() < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "%sio_uring register buffer ring failed. error = %d", spre ? spre : "", errno);
+					_ring.close();
+					freebufring_();
+					return -1;
+				}
+				_plog->add(CLOG_DEFAULT_MSG, "%sio_uring_setup success.", spre ? spre : "");
+
+				int sysfd = -1;
+				_fdwakeup = _net.eventfd_create_(&sysfd);
+				if (_fdwakeup < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "%seventfd create failed.", spre ? spre : "");
+					_ring.close();
+					freebufring_();
+					return -1;
+				}
+				if (pollin_(_fdwakeup) < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "%seventfd POLL_ADD failed.", spre ? spre : "");
+					_ring.close();
+					freebufring_();
+					_net.close_(_fdwakeup);
+					_fdwakeup = -1;
+					return -1;
+				}
+				_sysfdwakeup.store(sysfd, std::memory_order_release);
+				return 0;
+			}
+
+			/**
+			 * @brief 关闭所有连接和io_uring
+			 * @remark 用于退出时调用，不会通知应用层连接断开，应用层需自己释放和连接相关的资源。
+			*/
+			void close()
+			{
+				_sysfdwakeup.store(-1, std::memory_order_release);
+				_fdwakeup = -1;
+				_ring.close(); // 先关闭io_uring, 取消所有请求后再关闭fd
+				ec::vector<int> fds;
+				fds.reserve(1024);
+				_net.getall(fds);
+				for (auto& i : fds) {
+					_plog->add(CLOG_DEFAULT_DBG, "close fd(%d), fdtype = %d @serveruring_::close", i, _net.getfdtype(i));
+					_net.close_(i);
+				}
+				_rdpaused.clear();
+				_rearms.clear();
+			}
+
+			/**
+			 * @brief tcp listen
+			 * @param port port
+			 * @param sip  ipv4 or ipv6, nullptr or empty is ipv4 0.0.0.0
+			 * @param reuseport 1:SO_REUSEPORT, 多reactor监听同一端口
+			 * @return virtual fd; -1:failed
+			*/
+			int tcplisten(uint16_t port, const char* sip = nullptr, int ipv6only = 0, int reuseport = 0)
+			{
+				ec::net::socketaddr netaddr;
+				if (netaddr.set(port, sip) < 0)
+					return -1;
+				int addrlen = 0;
+				struct sockaddr* paddr = netaddr.getsockaddr(&addrlen);
+				if (!paddr)
+					return -1;
+				int fdl = _net.bind_listen(paddr, addrlen, ipv6only, reuseport);
+				if (fdl < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "bind listen tcp://%s:%u failed.", netaddr.viewip(), port);
+					return -1;
+				}
+				_plog->add(CLOG_DEFAULT_MSG, "fd(%d) bind listen tcp://%s:%u success.", fdl, netaddr.viewip(), port);
+				if (armaccept_(fdl) < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) io_uring ACCEPT failed.", fdl);
+					_net.close_(fdl);
+					return -1;
+				}
+				return fdl;
+			}
+
+			/**
+			 * @brief 使用已有的监听socket, 如热重启时从旧进程收到的
+			 * @param sysfd 系统fd, 成功后由本对象管理, 失败时关闭
+			 * @return virtual fd; -1:failed
+			*/
+			int tcplisten_fd(int sysfd)
+			{
+				int fdl = _net.attach_(sysfd, NETIO::fd_listen);
+				if (fdl < 0)
+					return -1;
+				if (armaccept_(fdl) < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) io_uring ACCEPT failed.", fdl);
+					_net.close_(fdl);
+					return -1;
+				}
+				return fdl;
+			}
+
+			/**
+			 * @brief 停止在监听fd上accept, 不关闭. 已提交的accept取消前接入的连接仍在本进程处理
+			 * @return 0:ok; -1:error
+			*/
+			int pauselisten(int fdl)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(fdl);
+				if (!pfd || NETIO::fd_listen != pfd->fdtype)
+					return -1;
+				pfd->pollevents |= EC_URING_F_RDPAUSE;
+				cancelfd_(fdl);
+				return 0;
+			}
+
+			/**
+			 * @brief 接入已连接的socket, 如热重启时从旧进程收到的, 和accept一样调用onAccept
+			 * @param sysfd 系统fd, 成功后由本对象管理, 失败时关闭
+			 * @param fdlisten 所属监听fd, 可为-1
+			 * @return virtual fd; -1:failed
+			*/
+			int tcpaccept_fd(int sysfd, int fdlisten)
+			{
+				fcntl(sysfd, F_SETFL, fcntl(sysfd, F_GETFL) | O_NONBLOCK);
+				int fdc = _net.attach_(sysfd, NETIO::fd_tcp);
+				if (fdc < 0)
+					return -1;
+				ec::net::socketaddr clientaddr;
+				socklen_t* paddrlen = nullptr;
+				struct sockaddr* paddr = clientaddr.getbuffer(&paddrlen);
+				uint16_t uport = 0;
+				char sip[48] = { 0 };
+				if (!getpeername(sysfd, paddr, paddrlen))
+					clientaddr.get(uport, sip, sizeof(sip));
+				onAccept(fdc, sip, uport, fdlisten);
+				if (_net.hasfd(fdc) && armrecv_(fdc) < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) io_uring RECV failed.", fdc);
+					closefd(fdc, 102);
+					return -1;
+				}
+				return fdc;
+			}
+
+			/**
+			 * @brief 移除连接但不断开. io_uring已提交的multishot recv异步取消, 期间到达的数据会被本进程读走, 不支持
+			 * @return -1
+			*/
+			int detachfd(int kfd)
+			{
+				return -1;
+			}
+
+			int udplisten(uint16_t port, const char* sip = nullptr, int ipv6only = 0) // return udp server fd, -1 error
+			{
+				ec::net::socketaddr netaddr;
+				if (netaddr.set(port, sip) < 0)
+					return -1;
+				int addrlen = 0;
+				struct sockaddr* paddr = netaddr.getsockaddr(&addrlen);
+				if (!paddr)
+					return -1;
+				if (!_udprbufs && !(_udprbufs = (char*)ec::g_malloc(EC_UDP_READ_FRMSIZE * FRMS_UDP_READ_ONCE))) {
+					_plog->add(CLOG_DEFAULT_ERR, "malloc udp receive buffer failed.");
+					return -1;
+				}
+				int fdl = _net.create_udp(paddr, addrlen, ipv6only);
+				if (fdl < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "bind udp://%s:%u failed.", netaddr.viewip(), port);
+					return -1;
+				}
+				_plog->add(CLOG_DEFAULT_MSG, "fd(%d) bind udp://%s:%u success.", fdl, netaddr.viewip(), port);
+				if (pollin_(fdl) < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) io_uring POLL_ADD failed.", fdl);
+					_net.close_(fdl);
+					return -1;
+				}
+				return fdl;
+			}
+
+			/**
+			 * @brief 运行时
+			 * @return 处理的完成项数; -1:io_uring未创建
+			*/
+			int runtime_(int waitmsec)
+			{
+				if (_ring.fd() < 0)
+					return -1;
+				int64_t curmstime = ec::mstime();
+				if ((_numaccepted || _numaccepterr) && llabs(curmstime - _lastacceptlog) >= 1000)
+					logaccept(curmstime);
+				dorecvflowctrl();
+				dorearms();
+				if ((!_rdpaused.empty() || !_rearms.empty()) && waitmsec > 4)
+					waitmsec = 4;
+#if EC_AIO_PROFILE
+				int64_t ust = ec::ustime_mono(), ust1;
+#endif
+				int nret = _ring.enter(_ring.cqready() ? 0 : waitmsec);
+				_ustwaitend = ec::ustime_mono();
+#if EC_AIO_PROFILE
+				_prof._wait.add(_ustwaitend - ust);
+				ust = _ustwaitend;
+#endif
+				_nsndctx = 0;
+				if (nret < 0 && -ETIME != nret && -EINTR != nret) {
+					if (_lastwaiterr != nret)
+						_plog->add(CLOG_DEFAULT_ERR, "io_uring_enter return %d", nret);
+					_lastwaiterr = nret;
+				}
+				struct io_uring_cqe cqe;
+				int n = 0;
+				while (n < EC_AIO_EVTS * 4 && _ring.getcqe(cqe)) {
+					oncqe(cqe);
+					++n;
+#if EC_AIO_PROFILE
+					ust1 = ec::ustime_mono();
+					_prof._event.add(ust1 - ust);
+					if (_prof.slow(ust1 - ust)) {
+						int kfd = (int)(uint32_t)cqe.user_data;
+						psession pss = getSession(kfd);
+						_plog->add(CLOG_DEFAULT_WRN, "slow cqe fd(%d) protocol %d(%s) op %d res %d %lld us", kfd,
+							pss ? pss->_protocol : -1, pss ? pss->ProtocolName(pss->_protocol) : "", (int)(cqe.user_data >> 32), cqe.res, (long long)(ust1 - ust));
+					}
+					ust = ust1;
+#endif
+				}
+				__atomic_store_n(&_bufring[0].resv, _buftail, __ATOMIC_RELEASE); // 归还接收缓冲
+				return n;
+			}
+
+			/**
+			 * @brief 设置可发送事件
+			 * @param kfd keyfd
+			*/
+			void sendtrigger(int kfd)
+			{
+				psession pss = getSession(kfd);
+				if (!pss)
+					return;
+				triger_evt(pss);
+			}
+
+			void udp_trigger(int kfd, bool bsend)
+			{
+				if (bsend)
+					udp_trigger(kfd);
+			}
+
+			void udp_trigger(int kfd)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				if (!pfd || (pfd->pollevents & EC_URING_F_POLLOUT))
+					return;
+				psession pss = getSession(kfd);
+				udb_buffer_* pfrms = pss ? pss->getudpsndbuffer() : nullptr;
+				if (!pfrms || pfrms->empty())
+					return;
+				udp_sendto(kfd);
+				if (!pfrms->empty())
+					pollout_(kfd);
+			}
+
+			/**
+			 * @brief 提交发送, sendmsg在下一次io_uring_enter时执行
+			 * @param kfd keyfd
+			 * @param overlap 未使用，兼容Windows版IOCP
+			 * @return  >=0: 待发送字节数;  -1:failed
+			*/
+			int postsend(int kfd, int overlap = 0)
+			{
+				psession pss = getSession(kfd);
+				if (!pss)
+					return -1;
+				if (triger_evt(pss) < 0)
+					return -1;
+				if (!(pss = getSession(kfd)))
+					return -1;
+				return (int)pss->_sndbuf.size();
+			}
+
+			/**
+			 * @brief 关闭连接，会产生onDisconnect和onDisconnected调用
+			 * @param kfd  keyfd
+			 * @param errorcode 网络错误码，0表示不是网络错误, 是服务端主动断开.
+			 * @return 0:关闭; -1:不存在，之前已经被关闭.
+			*/
+			int closefd(int kfd, int errorcode)
+			{
+				if (!_net.hasfd(kfd))
+					return -1;
+				if (!errorcode) {
+					onCloseFd(kfd);
+				}
+				onDisconnect(kfd);
+				cancelfd_(kfd);
+				_net.close_(kfd);
+				onDisconnected(kfd);
+				return 0;
+			}
+
+			size_t size_fds()
+			{
+				return _net.size();
+			}
+
+			inline int getbufsize(int fd, int op)
+			{
+				return _net.getbufsize(fd, op);
+			}
+		private:
+			static inline uint64_t udata_(int op, int kfd)
+			{
+				return ((uint64_t)op << 32) | (uint32_t)kfd;
+			}
+
+			void freebufring_()
+			{
+				if (_bufring) {
+					munmap(_bufring, EC_URING_RBUF_NUM * sizeof(struct io_uring_buf));
+					_bufring = nullptr;
+				}
+				if (_rbufs) {
+					munmap(_rbufs, (size_t)EC_URING_RBUF_NUM * EC_URING_RBUF_SIZE);
+					_rbufs = nullptr;
+				}
+			}
+
+			int openbufring_()
+			{
+				size_t zring = EC_URING_RBUF_NUM * sizeof(struct io_uring_buf);
+				void* pring = mmap(nullptr, zring, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (MAP_FAILED == pring)
+					return -1;
+				void* pbufs = mmap(nullptr, (size_t)EC_URING_RBUF_NUM * EC_URING_RBUF_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (MAP_FAILED == pbufs) {
+					munmap(pring, zring);
+					return -1;
+				}
+				_bufring = (struct io_uring_buf*)pring; // C++中io_uring_buf_ring::bufs的偏移不为0, 直接按数组使用
+				_rbufs = (char*)pbufs;
+				struct io_uring_buf_reg reg;
+				memset(&reg, 0, sizeof(reg));
+				reg.ring_addr = (uint64_t)(uintptr_t)_bufring;
+				reg.ring_entries = EC_URING_RBUF_NUM;
+				reg.bgid = 0;
+				if (_ring.registerx(IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+					return -1;
+				_buftail = 0;
+				for (int i = 0; i < EC_URING_RBUF_NUM; i++)
+					addbuf_(i);
+				__atomic_store_n(&_bufring[0].resv, _buftail, __ATOMIC_RELEASE);
+				return 0;
+			}
+
+			inline void addbuf_(int bid) // 归还一块接收缓冲, runtime_结束时一次发布
+			{
+				struct io_uring_buf* pb = &_bufring[_buftail & (EC_URING_RBUF_NUM - 1)];
+				pb->addr = (uint64_t)(uintptr_t)(_rbufs + (size_t)bid * EC_URING_RBUF_SIZE);
+				pb->len = EC_URING_RBUF_SIZE;
+				pb->bid = (uint16_t)bid;
+				++_buftail;
+			}
+
+			int armaccept_(int kfd)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				struct io_uring_sqe* sqe;
+				if (!pfd || nullptr == (sqe = _ring.getsqe()))
+					return -1;
+				sqe->opcode = IORING_OP_ACCEPT;
+				sqe->fd = pfd->sysfd;
+				sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+				sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+				sqe->user_data = udata_(uop_accept, kfd);
+				pfd->pollevents |= EC_URING_F_RECV;
+				return 0;
+			}
+
+			int armrecv_(int kfd)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				struct io_uring_sqe* sqe;
+				if (!pfd || nullptr == (sqe = _ring.getsqe()))
+					return -1;
+				sqe->opcode = IORING_OP_RECV;
+				sqe->fd = pfd->sysfd;
+				sqe->ioprio = IORING_RECV_MULTISHOT;
+				sqe->flags = IOSQE_BUFFER_SELECT;
+				sqe->buf_group = 0;
+				sqe->user_data = udata_(uop_recv, kfd);
+				pfd->pollevents |= EC_URING_F_RECV;
+				pfd->pollevents &= ~EC_URING_F_CANCEL;
+				return 0;
+			}
+
+			int pollin_(int kfd) // multishot POLLIN, 用于UDP和eventfd
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				struct io_uring_sqe* sqe;
+				if (!pfd || nullptr == (sqe = _ring.getsqe()))
+					return -1;
+				sqe->opcode = IORING_OP_POLL_ADD;
+				sqe->fd = pfd->sysfd;
+				sqe->len = IORING_POLL_ADD_MULTI;
+				sqe->poll32_events = POLLIN;
+				sqe->user_data = udata_(uop_pollin, kfd);
+				pfd->pollevents |= EC_URING_F_RECV;
+				return 0;
+			}
+
+			int pollout_(int kfd) // 单次POLLOUT, 用于异步连接和发送缓冲满
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				struct io_uring_sqe* sqe;
+				if (!pfd || nullptr == (sqe = _ring.getsqe()))
+					return -1;
+				sqe->opcode = IORING_OP_POLL_ADD;
+				sqe->fd = pfd->sysfd;
+				sqe->poll32_events = POLLOUT;
+				sqe->user_data = udata_(uop_pollout, kfd);
+				pfd->pollevents |= EC_URING_F_POLLOUT;
+				return 0;
+			}
+
+			/**
+			 * @brief 关闭系统fd前调用, 先提交已排队的请求(不能在fd号被重用后提交), 非TCP连接取消其上的multishot请求.
+			 * TCP连接在close_中shutdown, 未完成的请求会随之结束.
+			*/
+			void cancelfd_(int kfd)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				if (!pfd)
+					return;
+				struct io_uring_sqe* sqe;
+				if (NETIO::fd_tcp != pfd->fdtype && NETIO::fd_tcpout != pfd->fdtype && pfd->pollevents
+					&& nullptr != (sqe = _ring.getsqe())) {
+					sqe->opcode = IORING_OP_ASYNC_CANCEL;
+					sqe->fd = pfd->sysfd;
+					sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+					sqe->user_data = udata_(uop_cancel, kfd);
+				}
+				if (_ring.pending())
+					_ring.submit();
+				_nsndctx = 0;
+			}
+
+			void rearm_(int kfd)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				if (!pfd || (pfd->pollevents & EC_URING_F_REARM))
+					return;
+				pfd->pollevents |= EC_URING_F_REARM;
+				_rearms.push_back(kfd);
+			}
+
+			/**
+			 * @brief 重新提交已结束的multishot请求, UDP继续读
+			*/
+			void dorearms()
+			{
+				if (_rearms.empty())
+					return;
+				ec::vector<int> fds;
+				fds.swap(_rearms);
+				NETIO::t_fd* pfd;
+				for (auto& kfd : fds) {
+					if (nullptr == (pfd = _net.getmap().get(kfd)))
+						continue;
+					pfd->pollevents &= ~EC_URING_F_REARM;
+					if (NETIO::fd_udp == pfd->fdtype) {
+						if (!(pfd->pollevents & EC_URING_F_RECV))
+							pollin_(kfd);
+						onudpread(kfd);
+						continue;
+					}
+					if (pfd->pollevents & EC_URING_F_RECV)
+						continue;
+					if (NETIO::fd_listen == pfd->fdtype) {
+						if (!(pfd->pollevents & EC_URING_F_RDPAUSE))
+							armaccept_(kfd);
+					}
+					else if (NETIO::fd_event == pfd->fdtype)
+						pollin_(kfd);
+					else if (!(pfd->pollevents & EC_URING_F_RDPAUSE))
+						armrecv_(kfd);
+				}
+			}
+
+			/**
+			 * @brief 接收流控, onReceived后不能再接收的fd在下次runtime_时仍不能接收才取消multishot recv, 可接收后重新提交.
+			*/
+			void dorecvflowctrl()
+			{
+				if (_rdpaused.empty())
+					return;
+				ec::vector<int> fds;
+				fds.swap(_rdpaused);
+				NETIO::t_fd* pfd;
+				psession pss;
+				struct io_uring_sqe* sqe;
+				for (auto& kfd : fds) {
+					if (nullptr == (pfd = _net.getmap().get(kfd)))
+						continue;
+					if (nullptr == (pss = getSession(kfd))) {
+						pfd->pollevents &= ~EC_URING_F_RDPAUSE;
+						continue;
+					}
+					if (pss->_readpause || !sizeCanRecv(pss)) {
+						if ((pfd->pollevents & (EC_URING_F_RECV | EC_URING_F_CANCEL)) == EC_URING_F_RECV
+							&& nullptr != (sqe = _ring.getsqe())) {
+							sqe->opcode = IORING_OP_ASYNC_CANCEL;
+							sqe->addr = udata_(uop_recv, kfd);
+							sqe->user_data = udata_(uop_cancel, kfd);
+							pfd->pollevents |= EC_URING_F_CANCEL;
+							_plog->add(CLOG_DEFAULT_ALL, "fd(%d) %s pause reading for task balancing.",
+								kfd, pss->ProtocolName(pss->_protocol));
+						}
+						_rdpaused.push_back(kfd);
+						continue;
+					}
+					pfd->pollevents &= ~EC_URING_F_RDPAUSE;
+					if (!(pfd->pollevents & EC_URING_F_RECV))
+						armrecv_(kfd);
+				}
+			}
+
+			void logaccept(int64_t curmstime) // 输出accept汇总日志
+			{
+				if (_numaccepterr)
+					_plog->add(CLOG_DEFAULT_ERR, "accept %d connections, %d failed, last error %d", _numaccepted, _numaccepterr, _lastaccepterr);
+				else
+					_plog->add(CLOG_DEFAULT_INF, "accept %d connections", _numaccepted);
+				_numaccepted = 0;
+				_numaccepterr = 0;
+				_lastacceptlog = curmstime;
+			}
+
+			void oncqe(const struct io_uring_cqe& cqe)
+			{
+				int kfd = (int)(uint32_t)cqe.user_data;
+				switch ((int)(cqe.user_data >> 32)) {
+				case uop_accept:
+					onaccept(kfd, cqe);
+					break;
+				case uop_recv:
+					onrecv(kfd, cqe);
+					break;
+				case uop_send:
+					onsend(kfd, cqe.res);
+					break;
+				case uop_pollout:
+					onpollout(kfd, cqe.res);
+					break;
+				case uop_pollin:
+					onpollin(kfd, cqe);
+					break;
+				default:
+					break;
+				}
+			}
+
+			void onaccept(int fdlisten, const struct io_uring_cqe& cqe)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(fdlisten);
+				if (!pfd) { // 监听已关闭
+					if (cqe.res >= 0)
+						::close(cqe.res);
+					return;
+				}
+				if (!(cqe.flags & IORING_CQE_F_MORE)) {
+					pfd->pollevents &= ~EC_URING_F_RECV;
+					rearm_(fdlisten);
+				}
+				if (cqe.res < 0) {
+					if (-ECANCELED != cqe.res && -ECONNABORTED != cqe.res && -EINTR != cqe.res) {
+						_numaccepterr++;
+						_lastaccepterr = -cqe.res;
+					}
+					return;
+				}
+				int fdc = _net.attach_(cqe.res, NETIO::fd_tcp, true);
+				if (fdc < 0) {
+					_numaccepterr++;
+					_lastaccepterr = errno;
+					return;
+				}
+				_numaccepted++;
+				ec::net::socketaddr clientaddr;
+				socklen_t* paddrlen = nullptr;
+				struct sockaddr* paddr = clientaddr.getbuffer(&paddrlen);
+				uint16_t uport = 0;
+				char sip[48] = { 0 };
+				if (!getpeername(cqe.res, paddr, paddrlen))
+					clientaddr.get(uport, sip, sizeof(sip));
+				_plog->add(CLOG_DEFAULT_DBG, "fd(%d) accept from %s:%u at listen fd(%d)",
+					fdc, sip, uport, fdlisten);
+				onAccept(fdc, sip, uport, fdlisten);
+				if (_net.hasfd(fdc) && armrecv_(fdc) < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) io_uring RECV failed.", fdc);
+					closefd(fdc, 102);
+				}
+			}
+
+			void onrecv(int kfd, const struct io_uring_cqe& cqe)
+			{
+				int bid = (cqe.flags & IORING_CQE_F_BUFFER) ? (int)(cqe.flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+				onrecvbuf(kfd, cqe, bid >= 0 ? _rbufs + (size_t)bid * EC_URING_RBUF_SIZE : nullptr);
+				if (bid >= 0)
+					addbuf_(bid);
+			}
+
+			void onrecvbuf(int kfd, const struct io_uring_cqe& cqe, const char* pbuf)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				if (!pfd)
+					return;
+				bool bend = !(cqe.flags & IORING_CQE_F_MORE);
+				if (bend)
+					pfd->pollevents &= ~EC_URING_F_RECV;
+				if (cqe.res > 0 && pbuf) {
+#ifdef _DEBUG
+					_plog->add(CLOG_DEFAULT_ALL, "fd(%d) received %d bytes", kfd, cqe.res);
+#endif
+					if (onReceived(kfd, pbuf, cqe.res) < 0) {
+						closefd(kfd, 0); //主动断开
+						return;
+					}
+					psession pss = getSession(kfd); //onReceived中可能升级协议替换了session
+					if (!pss || triger_evt(pss) < 0)
+						return;
+					if (nullptr == (pfd = _net.getmap().get(kfd)))
+						return;
+					if ((pss->_readpause || !sizeCanRecv(pss)) && !(pfd->pollevents & EC_URING_F_RDPAUSE)) {
+						pfd->pollevents |= EC_URING_F_RDPAUSE;
+						_rdpaused.push_back(kfd);
+					}
+					if (bend)
+						rearm_(kfd);
+					return;
+				}
+				if (-ENOBUFS == cqe.res || -ECANCELED == cqe.res) { // 接收缓冲环用完或者流控取消
+					rearm_(kfd);
+					return;
+				}
+				if (cqe.res)
+					_plog->add(CLOG_DEFAULT_WRN, "fd(%d) disconnected at io_uring recv return %d", kfd, cqe.res);
+				else
+					_plog->add(CLOG_DEFAULT_DBG, "fd(%d) disconnected gracefully at io_uring recv return 0", kfd);
+				closefd(kfd, 102);//network dropped
+			}
+
+			void onsend(int kfd, int res)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				if (!pfd)
+					return;
+				pfd->pollevents &= ~EC_URING_F_SEND;
+				psession pss = getSession(kfd);
+				if (!pss)
+					return;
+				if (-EAGAIN == res || !res) {
+					pollout_(kfd);
+					return;
+				}
+				if (res < 0) {
+					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) sendbuf syserr %d", kfd, -res);
+					closefd(kfd, 102);//network dropped
+					return;
+				}
+#ifdef _DEBUG
+				_plog->add(CLOG_DEFAULT_ALL, "sendbuf fd(%d) size %d", kfd, res);
+#endif
+				pss->_sndbuf.freesize(res);
+				pss->_allsend += res;
+				pss->_bpsSnd.add(ec::mstime(), res);
+				if (pss->_lastsndbufsize != pss->_sndbuf.size()) {
+					pss->_lastsndbufsize = pss->_sndbuf.size();
+					onSendBufSizeChanged(kfd, pss->_lastsndbufsize, pss->_protocol);
+				}
+				onSendCompleted(kfd, res);
+				if (pss->_sndbuf.empty() && !pss->onSendCompleted()) {
+					_plog->add(CLOG_DEFAULT_WRN, "fd(%d) onSendCompleted false.", kfd);
+					closefd(kfd, 0);//主动断开
+					return;
+				}
+				triger_evt(pss);
+			}
+
+			void onpollout(int kfd, int res)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				if (!pfd)
+					return;
+				pfd->pollevents &= ~EC_URING_F_POLLOUT;
+				if (NETIO::fd_udp == pfd->fdtype) {
+					udp_trigger(kfd);
+					return;
+				}
+				psession pss = getSession(kfd);
+				if (!pss)
+					return;
+				if (NETIO::fd_tcpout == pfd->fdtype && pss->_status == EC_AIO_FD_CONNECTING) { // asyn connect out
+					int serr = 0;
+					socklen_t serrlen = sizeof(serr);
+					getsockopt(pfd->sysfd, SOL_SOCKET, SO_ERROR, (void*)&serr, &serrlen);
+					if (serr || res < 0) {
+						closefd(kfd, 111);//connection refused
+						return;
+					}
+					pss->_status = EC_AIO_FD_CONNECTED;
+					if (armrecv_(kfd) < 0) {
+						closefd(kfd, 102);
+						return;
+					}
+					onTcpOutConnected(kfd);
+					if (nullptr == (pss = getSession(kfd)))
+						return;
+				}
+				triger_evt(pss);
+			}
+
+			void onpollin(int kfd, const struct io_uring_cqe& cqe)
+			{
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				if (!pfd)
+					return;
+				if (!(cqe.flags & IORING_CQE_F_MORE)) {
+					pfd->pollevents &= ~EC_URING_F_RECV;
+					rearm_(kfd);
+				}
+				if (NETIO::fd_event == pfd->fdtype) {
+					uint64_t u = 0;
+					while (::read(pfd->sysfd, &u, sizeof(u)) > 0);
+					onWakeup();
+					return;
+				}
+				if (NETIO::fd_udp != pfd->fdtype)
+					return;
+				if (cqe.res > 0 && (cqe.res & (POLLERR | POLLHUP)))
+					_plog->add(CLOG_DEFAULT_ERR, "udp fd(%d)  error events %08XH", kfd, cqe.res);
+				onudpread(kfd);
+			}
+
+		protected:
+			/**
+			 * @brief 提交发送或者继续发送任务, 每个连接同时只有一个sendmsg或POLLOUT, 保证顺序
+			 * @return 0:ok; -1:连接已关闭
+			*/
+			int triger_evt(psession pss)
+			{
+				if (!pss)
+					return 0;
+				int kfd = pss->_fd;
+				NETIO::t_fd* pfd = _net.getmap().get(kfd);
+				if (!pfd || (pfd->pollevents & (EC_URING_F_SEND | EC_URING_F_POLLOUT)) || pss->_status == EC_AIO_FD_CONNECTING)
+					return 0;
+				if (pss->_sndbuf.empty()) {
+					if (!pss->hasSendJob())
+						return 0;
+					if (!pss->onSendCompleted()) {
+						_plog->add(CLOG_DEFAULT_WRN, "fd(%d) onSendCompleted false.", kfd);
+						closefd(kfd, 0);//主动断开
+						return -1;
+					}
+					if (pss->_sndbuf.empty())
+						return 0;
+				}
+				if (_nsndctx >= EC_URING_SNDCTX) { // 参数区用完, 先提交
+					_ring.submit();
+					_nsndctx = 0;
+				}
+				size_t zcan = sizeCanSend(pss);
+				if (!zcan)
+					return 0;
+				sndctx_& ctx = _sndctx[_nsndctx];
+				size_t zlen = 0;
+				int niov = pss->_sndbuf.getiov(ctx._iov, EC_AIO_SNDIOV_NUM, &zlen);
+				if (niov <= 0 || !zlen)
+					return 0;
+				niov = iovtrim(ctx._iov, niov, &zlen, zcan);
+				struct io_uring_sqe* sqe = _ring.getsqe();
+				if (!sqe) {
+					_plog->add(CLOG_DEFAULT_ERR, "fd(%d) io_uring submission queue full", kfd);
+					return 0;
+				}
+				memset(&ctx._msg, 0, sizeof(ctx._msg));
+				ctx._msg.msg_iov = ctx._iov;
+				ctx._msg.msg_iovlen = niov;
+				sqe->opcode = IORING_OP_SENDMSG;
+				sqe->fd = pfd->sysfd;
+				sqe->addr = (uint64_t)(uintptr_t)&ctx._msg;
+				sqe->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL; // 在提交时执行, 不进入内核工作线程
+				sqe->user_data = udata_(uop_send, kfd);
+				pfd->pollevents |= EC_URING_F_SEND;
+				++_nsndctx;
+				return 0;
+			}
+
+		private:
+			char* _udprbufs = nullptr; // FRMS_UDP_READ_ONCE * EC_UDP_READ_FRMSIZE, udplisten时分配
+			struct mmsghdr _udprmsgs[FRMS_UDP_READ_ONCE];
+			struct iovec _udpriovs[FRMS_UDP_READ_ONCE];
+			struct sockaddr_in6 _udpraddrs[FRMS_UDP_READ_ONCE];
+			udp_rfrm_ _udprfrms[FRMS_UDP_READ_ONCE];
+
+			/**
+			 * @brief multishot poll只在有新数据时通知, 读到不足一批为止, 超过EC_URING_UDP_READS次时下次继续
+			*/
+			void onudpread(int kfd)
+			{
+				if (!_udprbufs)
+					return;
+				int nr, i, n = 0;
+				do {
+					memset(_udprmsgs, 0, sizeof(_udprmsgs));
+					for (i = 0; i < FRMS_UDP_READ_ONCE; i++) {
+						_udpriovs[i].iov_base = _udprbufs + i * EC_UDP_READ_FRMSIZE;
+						_udpriovs[i].iov_len = EC_UDP_READ_FRMSIZE;
+						_udprmsgs[i].msg_hdr.msg_iov = &_udpriovs[i];
+						_udprmsgs[i].msg_hdr.msg_iovlen = 1;
+						_udprmsgs[i].msg_hdr.msg_name = &_udpraddrs[i];
+						_udprmsgs[i].msg_hdr.msg_namelen = sizeof(_udpraddrs[i]);
+					}
+					nr = _net.recvmmsg_(kfd, _udprmsgs, FRMS_UDP_READ_ONCE);
+					if (nr <= 0) {
+						if (nr < 0 && EAGAIN != errno && EWOULDBLOCK != errno)
+							_plog->add(CLOG_DEFAULT_ERR, "fd(%d) recvfrom failed. error %d", kfd, errno);
+						return;
+					}
+					for (i = 0; i < nr; i++) {
+						_udprfrms[i]._pdata = _udpriovs[i].iov_base;
+						_udprfrms[i]._size = _udprmsgs[i].msg_len;
+						_udprfrms[i]._paddr = (const struct sockaddr*)&_udpraddrs[i];
+						_udprfrms[i]._addrlen = (int)_udprmsgs[i].msg_hdr.msg_namelen;
+						if (_udprmsgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+							_plog->add(CLOG_DEFAULT_WRN, "fd(%d) recvfrom frame truncated to %d bytes.", kfd, EC_UDP_READ_FRMSIZE);
+					}
+					onReceivedFromBatch(kfd, _udprfrms, nr);
+					if (!_net.hasfd(kfd))
+						return;
+				} while (nr == FRMS_UDP_READ_ONCE && ++n < EC_URING_UDP_READS);
+				if (nr == FRMS_UDP_READ_ONCE)
+					rearm_(kfd);
+				udp_trigger(kfd);
+			}
+
+			struct mmsghdr _udpsmsgs[FRMS_UDP_SEND_ONCE];
+			struct iovec _udpsiovs[FRMS_UDP_SEND_ONCE];
+			void udp_sendto(int kfd)
+			{
+				psession pss = getSession(kfd);
+				if (!pss)
+					return;
+				udb_buffer_* pfrms = pss->getudpsndbuffer();
+				if (!pfrms)
+					return;
+				while (!pfrms->empty() && pfrms->front().empty())
+					pfrms->pop();
+				if (pfrms->empty())
+					return;
+				int numfrms = 0, nbytes = 0, ns, i;
+				memset(_udpsmsgs, 0, sizeof(_udpsmsgs));
+				for (auto& frm : *pfrms) { //一次sendmmsg最多FRMS_UDP_SEND_ONCE帧,32K字节
+					if (frm.empty() || numfrms >= FRMS_UDP_SEND_ONCE || nbytes >= 1024 * 32)
+						break;
+					_udpsiovs[numfrms].iov_base = frm.data();
+					_udpsiovs[numfrms].iov_len = frm.size();
+					_udpsmsgs[numfrms].msg_hdr.msg_iov = &_udpsiovs[numfrms];
+					_udpsmsgs[numfrms].msg_hdr.msg_iovlen = 1;
+					_udpsmsgs[numfrms].msg_hdr.msg_name = (void*)frm.getnetaddr();
+					_udpsmsgs[numfrms].msg_hdr.msg_namelen = (socklen_t)frm.netaddrlen();
+					nbytes += (int)frm.size();
+					++numfrms;
+				}
+				ns = _net.sendmmsg_(kfd, _udpsmsgs, numfrms);
+				if (ns < 0) {
+					if (EAGAIN != errno && EWOULDBLOCK != errno && ENOBUFS != errno) {
+						auto& frm = pfrms->front();
+						onSendtoFailed(kfd, frm.getnetaddr(), frm.netaddrlen(), frm.data(), frm.size(), errno);
+						pfrms->pop();
+					}
+					return;
+				}
+				nbytes = 0;
+				for (i = 0; i < ns; i++) {
+					nbytes += (int)pfrms->front().size();
+					pfrms->pop();
+				}
+				if (ns) {
+					pss->onUdpSendCount(ns, nbytes);
+					onSendCompleted(kfd, nbytes);
+				}
+			}
+		};
+	}//namespace aio
+}//namespace ec
@@ -4,10 +4,14 @@
 \author jiangyong
 \email  kipway@outlook.com
 \update 
+  2026.10.16 add lock-free mpscqueue
+  2026.10.16 add forward iterator
   2024.11.9 support none ec_alloctor
 
 queue
 	 FIFO context
+mpscqueue
+	 lock-free multi-producer single-consumer FIFO
 
 eclib 4.0 Copyright (c) 2017-2024, kipway
 source repository : https://github.com/kipway
@@ -16,6 +20,7 @@ Licensed under the Apache License, Version 2.0 (the "License");
 You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
 */
 #pragma once
+#include <atomic>
 namespace ec
 {
 	template<class _Ty>
@@ -45,6 +50,35 @@ namespace ec
 			}
 			_USE_EC_OBJ_ALLOCATOR
 		};
+		class iterator // forward iterator, 用于遍历不出队
+		{
+		private:
+			t_node* _pnode;
+		public:
+			iterator(t_node* pnode) : _pnode(pnode) {
+			}
+			inline reference operator*() const
+			{
+				return _pnode->value;
+			}
+			inline value_type* operator->() const
+			{
+				return &_pnode->value;
+			}
+			inline iterator& operator++()
+			{
+				_pnode = _pnode->pNext;
+				return *this;
+			}
+			inline bool operator==(const iterator& v) const
+			{
+				return _pnode == v._pnode;
+			}
+			inline bool operator!=(const iterator& v) const
+			{
+				return _pnode != v._pnode;
+			}
+		};
 	protected:
 		t_node* _phead;
 		t_node* _ptail;
@@ -73,6 +107,14 @@ namespace ec
 		{
 			return _phead->value;
 		}
+		inline iterator begin()
+		{
+			return iterator(_phead);
+		}
+		inline iterator end()
+		{
+			return iterator(nullptr);
+		}
 		inline reference& back() {
 			return _ptail->value;
 		}
@@ -163,4 +205,73 @@ namespace ec
 			++_size;
 		}
 	};
+
+	/**
+	 * @brief 无锁多生产者单消费者队列(Vyukov). emplace可在任意线程并发调用, pop和empty只能在一个消费线程调用.
+	 * 生产者入队后到链接完成前的瞬间消费者可能看不到该节点, 需要配合唤醒标志使用, 见netserver::postsend_from_any_thread
+	*/
+	template<class _Ty>
+	class mpscqueue
+	{
+	public:
+		using value_type = _Ty;
+	protected:
+		class t_node {
+		public:
+			std::atomic<t_node*> pNext;
+			value_type value;
+		public:
+			t_node() : pNext(nullptr) {
+			}
+			template <typename... Args>
+			t_node(int, Args&&... args) : pNext(nullptr), value(std::forward<Args>(args)...) {
+			}
+			_USE_EC_OBJ_ALLOCATOR
+		};
+		std::atomic<t_node*> _phead; // 生产者端, 最后入队的节点
+		t_node* _ptail; // 消费者端, 哑节点, 其后为第一个有效节点
+	public:
+		mpscqueue() : _phead(nullptr), _ptail(nullptr)
+		{
+			_ptail = new t_node();
+			_phead.store(_ptail, std::memory_order_relaxed);
+		}
+		~mpscqueue()
+		{
+			value_type v;
+			while (pop(v))
+				;
+			if (_ptail)
+				delete _ptail;
+		}
+		mpscqueue(const mpscqueue&) = delete;
+		mpscqueue& operator=(const mpscqueue&) = delete;
+
+		template <typename... Args>
+		bool emplace(Args&&... args)
+		{
+			t_node* pnode = new t_node(0, std::forward<Args>(args)...);
+			if (!pnode)
+				return false;
+			t_node* prev = _phead.exchange(pnode, std::memory_order_acq_rel);
+			prev->pNext.store(pnode, std::memory_order_release);
+			return true;
+		}
+
+		bool pop(value_type& v)
+		{
+			t_node* pnext = _ptail->pNext.load(std::memory_order_acquire);
+			if (!pnext)
+				return false;
+			v = std::move(pnext->value);
+			delete _ptail;
+			_ptail = pnext; // 成为新的哑节点
+			return true;
+		}
+
+		inline bool empty() const
+		{
+			return !_ptail->pNext.load(std::memory_order_acquire);
+		}
+	};
 }// namespace ec
@@ -59,6 +59,8 @@ window用法
  * 
  * @author jiangyong
  * 更新记录:
+ *   2026-10-16 OnHandover(),OnTakeover()注明线程要求; 交接时接收"ready"的超时改为100毫秒
+ *   2026-10-16 增加Linux热重启 -upgrade, 旧进程通过AF_UNIX socket(SCM_RIGHTS)把监听socket和空闲会话交给新进程后排空退出
  *   2024-12-6 增加关闭Windows服务模式
  *   2024-11-25 使用ec::string替换std::string
  *   2024-8-19 使用signal(SIGPIPE, SIG_IGN);忽略SIGPIPE信号
@@ -92,6 +94,10 @@ You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2
 #include<sys/ipc.h> 
 #include<sys/msg.h> 
 #include <termios.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #endif
 
 #include <signal.h>
@@ -218,6 +224,12 @@ int main(int argc, const char** argv)\
 #define _CTRLMAPBUF_ORDERINPOS 64 //输入命令起始地址
 #define _CTRLMAPBUF_ORDEROUTPOS 192 //输出命令起始地址
 
+#ifndef _WIN32
+#define _HOTRESTART_MAXFDS 250 // 热重启每个消息最多携带的fd数
+#define _HOTRESTART_MAXDATA (1024 * 60) // 热重启每个消息最多携带的数据
+#define _HOTRESTART_TIMEOUT (60 * 1000) // 旧进程等待新进程启动就绪的超时毫秒数
+#endif
+
 namespace ec {
 	/**
 	 * @brief 后台服务基类
@@ -244,6 +256,22 @@ namespace ec {
 		};
 		int	m_nlockfile; ///!linux版使用pid文件锁来判断一个驱动实例是否运行, 后台服务需要使用。
 		int _msgqueueid;///!主进程创建的临时消息队列ID，接收子进程发送的启动和停止信息, 主进程退出时，调用msgctrl清除队列，否则会在系统中存留。
+
+		struct t_hrmsg { // 热重启消息头, 一次交接由多个消息组成, 最后一个_last = 1
+			uint32_t _nfds; // SCM_RIGHTS携带的fd数
+			uint32_t _datalen; // 后跟的数据长度
+			uint32_t _last;
+		};
+		int _hrenable; ///!开启热重启
+		int _hrdrainsec; ///!交接后旧进程排空的超时秒数
+		int _hrlisten; ///!旧进程等待新进程连接的AF_UNIX socket
+		int _hrconn; ///!交接连接
+		int64_t _hrconnend; ///!等待新进程就绪的截止时间
+		int _hrlocked; ///!已持有pid文件锁, 新进程在旧进程交接完成后才能获得
+		int64_t _hrlocknext; ///!新进程下次尝试锁定的时间
+		int64_t _hrdrainend; ///!旧进程排空的截止时间, 0:未交接
+		ec::vector<int> _hrfds; ///!新进程收到的fd
+		ec::string _hrstate; ///!新进程收到的交接数据
 #endif
 	public:
 		void SetNoWindowsService() {
@@ -274,6 +302,44 @@ namespace ec {
 		*/
 		virtual void RunTime() = 0;
 
+#ifndef _WIN32
+		/**
+		 * @brief 热重启时旧进程导出要交接的fd和数据, 需EnableHotRestart()
+		 * @param nstep 0:新进程已连接, 导出监听socket, 之后两个进程都可以accept;
+		 *  1:新进程OnStart成功, 停止accept并导出空闲会话, 之后旧进程排空退出.
+		 * @param fds 输出dup出的fd, 发送后由框架关闭
+		 * @param state 输出交接数据
+		 * @return 0:交接; -1:不交接
+		 * @remark 在RunLoop线程中调用. netserver::handover_listen()/handover_sessions()不是线程安全的,
+		 *  服务在RunTime()中运行(和RunLoop同一线程)时可以直接调用; 服务在自己的线程(如ec::aio::reactors)中运行时,
+		 *  须把导出交给服务线程执行并等待完成, 或者先停止服务线程的runtime()再调用. 调用期间RunLoop不处理其他事务.
+		*/
+		virtual int OnHandover(int nstep, ec::vector<int>& fds, ec::string& state)
+		{
+			return -1;
+		}
+
+		/**
+		 * @brief 热重启时新进程在OnStart成功后导入旧进程第1步交接的fd和数据. 第0步的数据在OnStart中使用HandoverFds(),HandoverState()读取.
+		 * @param fds 收到的fd, 应用接管后应清空, 剩余的由框架关闭
+		 * @param state 交接数据
+		 * @remark 在主线程中调用, 此时RunLoop还未开始. netserver::handover_import()不是线程安全的,
+		 *  服务已在自己的线程中运行时, 须把导入交给服务线程执行并等待完成.
+		*/
+		virtual void OnTakeover(ec::vector<int>& fds, ec::string& state)
+		{
+		}
+
+		/**
+		 * @brief 热重启交接完成后旧进程在RunLoop中循环调用, 判断剩余会话是否处理完毕
+		 * @return true:已排空,退出; false:继续等待直到超时
+		*/
+		virtual bool OnDrain()
+		{
+			return false;
+		}
+#endif
+
 	public: //应用层需要重载的基本信息
 		/**
 		 * @brief 版本信息，应用层重载。
@@ -390,8 +456,35 @@ namespace ec {
 			printf("  -debug : debug run\n"); //调试模式运行,不附加任何功能，应用自己的命令行参数放在后面。
 			printf("  -stop : Stop run in the background\n");
 			printf("  -kill : force stop run in the background\n");
+			printf("  -upgrade : start a new process to take over the running one\n"); //热重启, 需应用开启EnableHotRestart
 			printf("  -help : view this information\n");
 		}
+
+		/**
+		 * @brief 开启热重启, 在OnStart中调用. 持有pid文件锁的进程监听pid文件同名的.sock文件, 等待-upgrade启动的新进程连接.
+		 * @param draintimeoutsec 交接后旧进程排空的超时秒数
+		*/
+		void EnableHotRestart(int draintimeoutsec = 60)
+		{
+			_hrenable = 1;
+			_hrdrainsec = draintimeoutsec > 0 ? draintimeoutsec : 1;
+		}
+
+		/**
+		 * @brief 新进程在OnStart中读取第0步交接的fd, 应用接管后应清空, 剩余的由框架关闭
+		*/
+		inline ec::vector<int>& HandoverFds()
+		{
+			return _hrfds;
+		}
+
+		/**
+		 * @brief 新进程在OnStart中读取第0步交接的数据
+		*/
+		inline const ec::string& HandoverState() const
+		{
+			return _hrstate;
+		}
 #endif
 		
 	public:
@@ -419,6 +512,14 @@ namespace ec {
 #else
 			m_nlockfile = -1;
 			_msgqueueid = -1;
+			_hrenable = 0;
+			_hrdrainsec = 60;
+			_hrlisten = -1;
+			_hrconn = -1;
+			_hrconnend = 0;
+			_hrlocked = 1;
+			_hrlocknext = 0;
+			_hrdrainend = 0;
 #endif
 
 		}
@@ -440,6 +541,7 @@ namespace ec {
 				close(m_nlockfile);
 				m_nlockfile = -1;
 			}
+			HrClose(true);
 #endif
 		}
 
@@ -1083,6 +1185,309 @@ namespace ec {
 			dup2(fd, 2);
 			close(fd);
 		}
+
+		/**
+		 * @brief 热重启socket文件名, pid文件的.pid替换为.sock
+		*/
+		void HrPath(ec::string& so)
+		{
+			so = _pidpathfile;
+			if (so.size() > 4 && !strcmp(so.c_str() + so.size() - 4, ".pid"))
+				so.resize(so.size() - 4);
+			so.append(".sock");
+		}
+
+		static void HrCloseFds(ec::vector<int>& fds)
+		{
+			for (auto& i : fds) {
+				if (i >= 0)
+					close(i);
+			}
+			fds.clear();
+		}
+
+		/**
+		 * @brief 关闭热重启连接
+		 * @param blisten 同时关闭监听并删除socket文件
+		*/
+		void HrClose(bool blisten)
+		{
+			if (_hrconn >= 0) {
+				close(_hrconn);
+				_hrconn = -1;
+			}
+			if (blisten && _hrlisten >= 0) {
+				close(_hrlisten);
+				_hrlisten = -1;
+				ec::string spath;
+				HrPath(spath);
+				unlink(spath.c_str());
+			}
+		}
+
+		/**
+		 * @brief 发送交接fd和数据, fd和数据分多个消息发送
+		 * @return 0:success; -1:failed
+		*/
+		static int HrSend(int fd, const ec::vector<int>& fds, const ec::string& data)
+		{
+			size_t posfd = 0, posdata = 0;
+			do {
+				t_hrmsg h;
+				h._nfds = (uint32_t)(fds.size() - posfd > _HOTRESTART_MAXFDS ? _HOTRESTART_MAXFDS : fds.size() - posfd);
+				h._datalen = (uint32_t)(data.size() - posdata > _HOTRESTART_MAXDATA ? _HOTRESTART_MAXDATA : data.size() - posdata);
+				h._last = (posfd + h._nfds == fds.size() && posdata + h._datalen == data.size()) ? 1 : 0;
+				struct iovec iov[2];
+				iov[0].iov_base = &h;
+				iov[0].iov_len = sizeof(h);
+				iov[1].iov_base = (void*)(data.data() + posdata);
+				iov[1].iov_len = h._datalen;
+				char cbuf[CMSG_SPACE(sizeof(int) * _HOTRESTART_MAXFDS)];
+				struct msghdr msg;
+				memset(&msg, 0, sizeof(msg));
+				msg.msg_iov = iov;
+				msg.msg_iovlen = h._datalen ? 2 : 1;
+				if (h._nfds) {
+					memset(cbuf, 0, sizeof(cbuf));
+					msg.msg_control = cbuf;
+					msg.msg_controllen = CMSG_SPACE(sizeof(int) * h._nfds);
+					struct cmsghdr* pcm = CMSG_FIRSTHDR(&msg);
+					pcm->cmsg_level = SOL_SOCKET;
+					pcm->cmsg_type = SCM_RIGHTS;
+					pcm->cmsg_len = CMSG_LEN(sizeof(int) * h._nfds);
+					memcpy(CMSG_DATA(pcm), fds.data() + posfd, sizeof(int) * h._nfds);
+				}
+				ssize_t ns;
+				do {
+					ns = sendmsg(fd, &msg, MSG_NOSIGNAL);
+				} while (ns < 0 && EINTR == errno);
+				if (ns != (ssize_t)(sizeof(h) + h._datalen))
+					return -1;
+				posfd += h._nfds;
+				posdata += h._datalen;
+			} while (posfd < fds.size() || posdata < data.size());
+			return 0;
+		}
+
+		/**
+		 * @brief 接收HrSend发送的fd和数据
+		 * @param mstimeout 每个消息的超时毫秒数
+		 * @return 0:success; -1:failed or timeout, 已收到的fd已关闭
+		*/
+		static int HrRecv(int fd, ec::vector<int>& fds, ec::string& data, int mstimeout)
+		{
+			ec::vector<char> buf;
+			buf.resize(sizeof(t_hrmsg) + _HOTRESTART_MAXDATA);
+			char cbuf[CMSG_SPACE(sizeof(int) * _HOTRESTART_MAXFDS)];
+			for (;;) {
+				struct pollfd pfd;
+				pfd.fd = fd;
+				pfd.events = POLLIN;
+				pfd.revents = 0;
+				int np = poll(&pfd, 1, mstimeout);
+				if (np < 0 && EINTR == errno)
+					continue;
+				if (np <= 0)
+					break;
+				struct iovec iov;
+				iov.iov_base = buf.data();
+				iov.iov_len = buf.size();
+				struct msghdr msg;
+				memset(&msg, 0, sizeof(msg));
+				msg.msg_iov = &iov;
+				msg.msg_iovlen = 1;
+				msg.msg_control = cbuf;
+				msg.msg_controllen = sizeof(cbuf);
+				ssize_t nr = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+				if (nr < 0 && EINTR == errno)
+					continue;
+				for (struct cmsghdr* pcm = nr > 0 ? CMSG_FIRSTHDR(&msg) : nullptr; pcm; pcm = CMSG_NXTHDR(&msg, pcm)) {
+					if (SOL_SOCKET == pcm->cmsg_level && SCM_RIGHTS == pcm->cmsg_type) {
+						size_t n = (pcm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+						const int* pfds = (const int*)CMSG_DATA(pcm);
+						for (size_t i = 0; i < n; i++)
+							fds.push_back(pfds[i]);
+					}
+				}
+				t_hrmsg h;
+				if (nr < (ssize_t)sizeof(h) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+					break;
+				memcpy(&h, buf.data(), sizeof(h));
+				if (nr != (ssize_t)(sizeof(h) + h._datalen))
+					break;
+				data.append(buf.data() + sizeof(h), h._datalen);
+				if (h._last)
+					return 0;
+			}
+			HrCloseFds(fds);
+			data.clear();
+			return -1;
+		}
+
+		/**
+		 * @brief 创建等待新进程连接的socket, 持有pid锁的进程调用
+		*/
+		int HrListen()
+		{
+			ec::string spath;
+			HrPath(spath);
+			struct sockaddr_un addr;
+			memset(&addr, 0, sizeof(addr));
+			if (spath.size() >= sizeof(addr.sun_path))
+				return -1;
+			addr.sun_family = AF_UNIX;
+			memcpy(addr.sun_path, spath.data(), spath.size());
+			int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd < 0)
+				return -1;
+			unlink(spath.c_str());
+			if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+				close(fd);
+				return -1;
+			}
+			chmod(spath.c_str(), S_IRUSR | S_IWUSR);
+			_hrlisten = fd;
+			return 0;
+		}
+
+		/**
+		 * @brief 新进程连接旧进程
+		 * @return 连接的fd; -1:failed
+		*/
+		int HrConnect()
+		{
+			ec::string spath;
+			HrPath(spath);
+			struct sockaddr_un addr;
+			memset(&addr, 0, sizeof(addr));
+			if (spath.size() >= sizeof(addr.sun_path))
+				return -1;
+			addr.sun_family = AF_UNIX;
+			memcpy(addr.sun_path, spath.data(), spath.size());
+			int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+			if (fd < 0)
+				return -1;
+			if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+				close(fd);
+				return -1;
+			}
+			return fd;
+		}
+
+		/**
+		 * @brief 旧进程导出并发送一步交接
+		 * @return 0:success; -1:failed
+		*/
+		int HrHandover(int nstep)
+		{
+			ec::vector<int> fds;
+			ec::string state;
+			int nr = OnHandover(nstep, fds, state);
+			if (nr >= 0)
+				nr = HrSend(_hrconn, fds, state);
+			HrCloseFds(fds);
+			return nr;
+		}
+
+		/**
+		 * @brief 在RunLoop中循环调用, 处理热重启
+		*/
+		void HrRunTime()
+		{
+			int64_t msnow = mstime();
+			if (!_hrlocked) { // 新进程等待旧进程交接完成后释放pid锁
+				if (msnow < _hrlocknext)
+					return;
+				_hrlocknext = msnow + 100;
+				struct flock fl;
+				memset(&fl, 0, sizeof(fl));
+				fl.l_whence = SEEK_SET;
+				fl.l_type = F_WRLCK;
+				if (m_nlockfile >= 0 && fcntl(m_nlockfile, F_GETLK, &fl) >= 0 && F_UNLCK == fl.l_type && !LockFile(m_nlockfile))
+					_hrlocked = 1;
+				return;
+			}
+			if (_hrdrainend) { // 旧进程排空
+				if (OnDrain() || msnow > _hrdrainend)
+					_sigval = 0;
+				return;
+			}
+			if (!_hrenable)
+				return;
+			if (_hrlisten < 0 && HrListen() < 0) {
+				_hrenable = 0;
+				return;
+			}
+			if (_hrconn < 0) {
+				_hrconn = accept4(_hrlisten, nullptr, nullptr, SOCK_CLOEXEC);
+				if (_hrconn < 0)
+					return;
+				_hrconnend = msnow + _HOTRESTART_TIMEOUT;
+				if (HrHandover(0) < 0)
+					HrClose(false);
+				return;
+			}
+			struct pollfd pfd;
+			pfd.fd = _hrconn;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			if (poll(&pfd, 1, 0) <= 0) {
+				if (msnow > _hrconnend) // 新进程启动超时, 放弃交接
+					HrClose(false);
+				return;
+			}
+			ec::vector<int> fds;
+			ec::string order;
+			if (HrRecv(_hrconn, fds, order, 100) < 0 || order != "ready") { // 新进程启动失败; 已可读, "ready"是单个消息, 不会等满超时
+				HrCloseFds(fds);
+				HrClose(false);
+				return;
+			}
+			HrHandover(1);
+			HrClose(true);
+			if (m_nlockfile >= 0) { // 释放pid锁, 新进程接管
+				close(m_nlockfile);
+				m_nlockfile = -1;
+			}
+			_hrdrainend = msnow + _hrdrainsec * 1000LL;
+		}
+
+		/**
+		 * @brief 新进程接管, 连接旧进程接收第0步交接, OnStart成功后通知旧进程并接收第1步交接
+		 * @param argc OnStart参数个数
+		 * @param argv OnStart参数
+		 * @return OnStart的返回值; -1:交接失败
+		*/
+		int HrTakeover(int argc, const char** argv)
+		{
+			int fd = HrConnect();
+			if (fd < 0) {
+				printf("connect to %s failed, hot restart is not enabled?\n", _instname.c_str());
+				return -1;
+			}
+			if (HrRecv(fd, _hrfds, _hrstate, 10 * 1000) < 0) {
+				close(fd);
+				printf("receive handover from %s failed.\n", _instname.c_str());
+				return -1;
+			}
+			int nst = OnStart(argc, argv);
+			HrCloseFds(_hrfds);
+			_hrstate.clear();
+			if (nst < 0) {
+				close(fd);
+				return nst;
+			}
+			ec::vector<int> fdsready;
+			ec::string order("ready");
+			if (!HrSend(fd, fdsready, order) && !HrRecv(fd, _hrfds, _hrstate, 10 * 1000))
+				OnTakeover(_hrfds, _hrstate);
+			else
+				printf("handover sessions from %s failed.\n", _instname.c_str());
+			HrCloseFds(_hrfds);
+			_hrstate.clear();
+			close(fd);
+			return nst;
+		}
 #endif
 
 		/**
@@ -1159,6 +1564,9 @@ namespace ec {
 			ec::string order;
 			while (-1 == _sigval) {
 				RunTime();
+#ifndef _WIN32
+				HrRunTime();
+#endif
 #ifdef _WIN32
 				if (ReadMessage(order, _CTRLMAPBUF_ORDERINPOS) > 0 && !strcmp("order_stop", order.c_str())) {
 					_sigval = CTRL_CLOSE_EVENT;
@@ -1178,9 +1586,11 @@ namespace ec {
 		 * @brief 子进程开始运行
 		 * @param argc
 		 * @param argv
+		 * @param directrun 前台直接运行
+		 * @param takeover 热重启接管运行中的旧进程(linux)
 		 * @return -1: failed; 0:成功； 1: 已经存在
 		*/
-		int StartRun(int argc, const char** argv, bool directrun = false)
+		int StartRun(int argc, const char** argv, bool directrun = false, bool takeover = false)
 		{
 #ifdef _WIN32
 			if (isService()) 
@@ -1190,19 +1600,22 @@ namespace ec {
 			if (CreateMessageQueue() != 0)
 				return -1;
 			SetConsoleCtrlHandler(exit_HandlerRoutine, TRUE);
+			int nst = OnStart(argc, argv);
 #else
 			int npid = CheckLock();
 			if (npid < 0) {
 				return -1;
 			}
 			else if (npid > 0) {
-				return 1;
+				if (!takeover)
+					return 1;
+				_hrlocked = 0; // 旧进程交接完成后才能锁定
 			}
 			signal(SIGPIPE, SIG_IGN);
 			signal(SIGTERM, exit_handler);
 			signal(SIGINT, exit_handler);
+			int nst = takeover ? HrTakeover(argc, argv) : OnStart(argc, argv);
 #endif
-			int nst = OnStart(argc, argv);
 #ifdef _WIN32
 			FreeConsole(); //释放控制台,避免控制台关闭后进程杀掉。
 #else
@@ -1358,7 +1771,11 @@ namespace ec {
 			}
 			std::vector<const char*> vargs;//清零的纯应用层参数。
 			vargs.reserve(argc);
-			if (!strcmp(argv[1], "-start") || !strcmp(argv[1], "-run") || !strcmp(argv[1], "-service") || !strcmp(argv[1], "-debug")) {
+			if (!strcmp(argv[1], "-start") || !strcmp(argv[1], "-run") || !strcmp(argv[1], "-service") || !strcmp(argv[1], "-debug")
+#ifndef _WIN32
+				|| !strcmp(argv[1], "-upgrade") || !strcmp(argv[1], "-takeover")
+#endif
+				) {
 				for (i = 0; i < argc; i++) {
 					if (i != 1)
 						vargs.push_back(argv[i]); //去掉"-run"，"-service", "-debug" 还原app原始命令行参数
@@ -1372,8 +1789,22 @@ namespace ec {
 				return -1;
 			if (!CheckPrivilege())
 				return -1;
+#endif
+#ifndef _WIN32
+			bool bupgrade = !strcmp(argv[1], "-upgrade");
+			if (!strcmp(argv[1], "-takeover")) // -upgrade创建的子进程
+				return StartRun((int)vargs.size(), vargs.data(), false, true);
 #endif
 			npid = getProcessID();
+#ifndef _WIN32
+			if (bupgrade) {
+				if (npid <= 0) {
+					printf("%s is not run.\n", _instname.c_str());
+					return -1;
+				}
+			}
+			else
+#endif
 			if (npid > 0) {
 				printf("%s alreay runing. PID = %d\n", _instname.c_str(), npid);
 				return 0;
@@ -1389,7 +1820,11 @@ namespace ec {
 				return StartRun((int)vargs.size(), vargs.data(), !strcmp(argv[1], "-run"));
 			}
 
-			if (strcmp(argv[1], "-start")){
+			if (strcmp(argv[1], "-start")
+#ifndef _WIN32
+				&& !bupgrade
+#endif
+				) {
 				Usage();
 				return -1;
 			}
@@ -1434,7 +1869,7 @@ namespace ec {
 #else		
 			vargs.clear();
 			vargs.push_back(argv[0]);
-			vargs.push_back("-service"); // linux使用-service作为后台服务和直接启动
+			vargs.push_back(bupgrade ? "-takeover" : "-service"); // linux使用-service作为后台服务和直接启动
 			for (i=2; i < argc; i++) {
 				vargs.push_back(argv[i]);
 			}
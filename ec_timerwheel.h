@@ -0,0 +1,252 @@
+﻿/*!
+\file ec_timerwheel.h
+
+hierarchical timer wheel
+
+4层时间轮, 每层64个槽, 添加和取消定时器O(1), 推进时只处理到期的槽位和需要下移的上层槽位.
+精度为一个tick(构造时设置毫秒数), 超过最大范围(64^4个tick)的定时器先放在最高层, 下移时按实际到期时间重新放置, 不会提前到期.
+
+\author  jiangyong
+\update
+  2026-10-16 超过最大范围的定时器保留实际到期时间, 不再截断为最大范围
+  2026-10-16 first version
+
+eclib 4.0 Copyright (c) 2017-2024, kipway
+source repository : https://github.com/kipway
+
+Licensed under the Apache License, Version 2.0 (the "License");
+You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+*/
+
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include "ec_vector.hpp"
+
+#define EC_TMWHEEL_BITS 6 // 每层槽位数位数
+#define EC_TMWHEEL_SLOTS (1 << EC_TMWHEEL_BITS)
+#define EC_TMWHEEL_LEVELS 4
+#define EC_TMWHEEL_IDXBITS 20 // 定时器id低位为节点序号, 最多同时2^20个定时器
+
+namespace ec {
+	/**
+	 * @brief 时间轮定时器
+	 * @code
+	 *	ec::timerwheel tw(10);
+	 *	int id = tw.add(fd, 1, 5000); // 5秒后到期
+	 *	tw.cancel(id);
+	 *	tw.run(ec::mstime_mono(), [](int id, int fd, int type, std::function<void(int, int)>& cb) {
+	 *		...
+	 *	});
+	 * @endcode
+	*/
+	class timerwheel
+	{
+	public:
+		using callback = std::function<void(int fd, int timerid)>;
+	protected:
+		struct node_ {
+			int64_t _expire; // 到期tick
+			int _prev; // 槽内双向链表, -1结束
+			int _next; // 槽内双向链表, 空闲时为下一个空闲节点
+			int _slot; // 所在槽位(level * EC_TMWHEEL_SLOTS + idx), -1:空闲, -2:已到期待处理, -3:到期后被取消
+			int _gen; // 代号, 防止取消已重用节点
+			int _fd;
+			int _type;
+			callback _cb;
+		};
+		ec::vector<node_> _nodes;
+		int _heads[EC_TMWHEEL_LEVELS * EC_TMWHEEL_SLOTS];
+		int _free; // 空闲节点链表
+		size_t _size;
+		int _msTick;
+		int64_t _curtick; // 已处理到的tick
+		int64_t _msbase; // tick 0对应的时间
+		ec::vector<int> _expired; // 推进时收集的到期节点
+
+		void link_(int i)
+		{
+			node_& n = _nodes[i];
+			int64_t delta = n._expire - _curtick, range = EC_TMWHEEL_SLOTS;
+			if (delta < 0) { // 下移时已到期,放入当前槽位
+				n._expire = _curtick;
+				delta = 0;
+			}
+			int level = 0;
+			while (level < EC_TMWHEEL_LEVELS - 1 && delta >= range) {
+				++level;
+				range <<= EC_TMWHEEL_BITS;
+			}
+			int64_t texpire = n._expire;
+			if (delta >= range) // 超过最大范围, 放在最高层最远的槽位, 下移时再按_expire重新放置
+				texpire = _curtick + range - 1;
+			int slot = level * EC_TMWHEEL_SLOTS + (int)((texpire >> (level * EC_TMWHEEL_BITS)) & (EC_TMWHEEL_SLOTS - 1));
+			n._slot = slot;
+			n._prev = -1;
+			n._next = _heads[slot];
+			if (n._next >= 0)
+				_nodes[n._next]._prev = i;
+			_heads[slot] = i;
+		}
+
+		void unlink_(int i)
+		{
+			node_& n = _nodes[i];
+			if (n._prev >= 0)
+				_nodes[n._prev]._next = n._next;
+			else
+				_heads[n._slot] = n._next;
+			if (n._next >= 0)
+				_nodes[n._next]._prev = n._prev;
+			n._slot = -1;
+		}
+
+		void free_(int i)
+		{
+			node_& n = _nodes[i];
+			n._slot = -1;
+			n._cb = nullptr;
+			n._next = _free;
+			_free = i;
+			--_size;
+		}
+
+		void cascade_(int level, int idx) // 上层槽位下移
+		{
+			int slot = level * EC_TMWHEEL_SLOTS + idx, i = _heads[slot], next;
+			_heads[slot] = -1;
+			while (i >= 0) {
+				next = _nodes[i]._next;
+				link_(i);
+				i = next;
+			}
+		}
+
+		void tick_() // 推进一个tick, 到期的节点放入_expired
+		{
+			++_curtick;
+			int level, idx = (int)(_curtick & (EC_TMWHEEL_SLOTS - 1));
+			if (!idx) {
+				for (level = 1; level < EC_TMWHEEL_LEVELS; level++) {
+					idx = (int)((_curtick >> (level * EC_TMWHEEL_BITS)) & (EC_TMWHEEL_SLOTS - 1));
+					cascade_(level, idx);
+					if (idx)
+						break;
+				}
+				idx = 0;
+			}
+			int i = _heads[idx];
+			_heads[idx] = -1;
+			while (i >= 0) {
+				_nodes[i]._slot = -2;
+				_expired.push_back(i);
+				i = _nodes[i]._next;
+			}
+		}
+	public:
+		timerwheel(int msTick = 10) : _free(-1), _size(0), _msTick(msTick > 0 ? msTick : 1), _curtick(0), _msbase(-1)
+		{
+			for (auto& i : _heads)
+				i = -1;
+		}
+
+		inline size_t size() const
+		{
+			return _size;
+		}
+
+		inline int mstick() const
+		{
+			return _msTick;
+		}
+
+		/**
+		 * @brief 添加定时器
+		 * @param fd 关联的fd
+		 * @param type 类型, 由使用者定义
+		 * @param msdelay 延时毫秒数
+		 * @param cb 回调, 可为nullptr
+		 * @return 定时器id(>0); -1:定时器数已满
+		*/
+		int add(int fd, int type, int64_t msdelay, callback cb = nullptr)
+		{
+			int i;
+			if (_free >= 0) {
+				i = _free;
+				_free = _nodes[i]._next;
+			}
+			else {
+				if (_nodes.size() >= (1u << EC_TMWHEEL_IDXBITS))
+					return -1;
+				_nodes.emplace_back();
+				i = (int)_nodes.size() - 1;
+				_nodes[i]._gen = 0;
+			}
+			node_& n = _nodes[i];
+			n._gen = (n._gen % ((INT32_MAX >> EC_TMWHEEL_IDXBITS) - 1)) + 1;
+			n._fd = fd;
+			n._type = type;
+			n._cb = std::move(cb);
+			n._expire = _curtick + (msdelay > _msTick ? (msdelay + _msTick - 1) / _msTick : 1);
+			link_(i);
+			++_size;
+			return (n._gen << EC_TMWHEEL_IDXBITS) | i;
+		}
+
+		/**
+		 * @brief 取消定时器
+		 * @return true:已取消; false:不存在或已到期
+		*/
+		bool cancel(int id)
+		{
+			int i = id & ((1 << EC_TMWHEEL_IDXBITS) - 1);
+			if (id <= 0 || i >= (int)_nodes.size() || _nodes[i]._gen != (id >> EC_TMWHEEL_IDXBITS))
+				return false;
+			if (-2 == _nodes[i]._slot) { // 已到期还未回调
+				_nodes[i]._slot = -3;
+				return true;
+			}
+			if (_nodes[i]._slot < 0)
+				return false;
+			unlink_(i);
+			free_(i);
+			return true;
+		}
+
+		/**
+		 * @brief 推进到当前时间并处理到期的定时器, fun中可以添加和取消定时器
+		 * @param msnow 单调递增的当前毫秒时间, 如ec::mstime_mono()
+		 * @param fun 到期处理 void fun(int id, int fd, int type, callback& cb)
+		 * @return 到期的定时器数
+		*/
+		template<class _Fun>
+		int run(int64_t msnow, _Fun&& fun)
+		{
+			if (_msbase < 0)
+				_msbase = msnow;
+			int64_t target = (msnow - _msbase) / _msTick;
+			if (target <= _curtick)
+				return 0;
+			while (_curtick < target)
+				tick_();
+			int n = 0, id;
+			callback cb;
+			for (size_t k = 0; k < _expired.size(); k++) { // fun中add可能使_nodes重新分配,先复制出来
+				int i = _expired[k];
+				node_& nd = _nodes[i];
+				if (-3 == nd._slot) {
+					free_(i);
+					continue;
+				}
+				int fd = nd._fd, type = nd._type;
+				id = (nd._gen << EC_TMWHEEL_IDXBITS) | i;
+				cb = std::move(nd._cb);
+				free_(i);
+				fun(id, fd, type, cb);
+				++n;
+			}
+			_expired.clear();
+			return n;
+		}
+	};
+}// namespace ec
@@ -3,6 +3,7 @@
 \author	jiangyong
 \email  kipway@outlook.com
 \update 2023.5.13
+2026.10.16 add ws_make_head()
 2023.5.13 use zlibe self memory allocator
 
 functions used by websocket
@@ -150,6 +151,32 @@ namespace ec
 		return err == Z_STREAM_END ? 0 : err;
 	}
 
+	/**
+	 * @brief 生成服务端不带掩码的帧头
+	 * @param pout 输出, 至少10字节
+	 * @param uc 第一字节, FIN, RSV, opcode
+	 * @param us 帧数据长度
+	 * @return 帧头长度
+	*/
+	inline size_t ws_make_head(uint8_t* pout, unsigned char uc, size_t us)
+	{
+		pout[0] = uc;
+		if (us < 126) {
+			pout[1] = (uint8_t)us;
+			return 2;
+		}
+		else if (us < 65536) {
+			pout[1] = 126;
+			pout[2] = (uint8_t)(us >> 8);
+			pout[3] = (uint8_t)(us & 0xFF);
+			return 4;
+		}
+		pout[1] = 127;
+		for (int i = 0; i < 8; i++)
+			pout[2 + i] = (uint8_t)(((uint64_t)us >> (56 - 8 * i)) & 0xFF);
+		return 10;
+	}
+
 	template <class _Out = vstream>
 	bool ws_make_permsg(const void* pdata, size_t sizes, unsigned char wsopt, _Out* pout, int ncompress, uint32_t umask = 0) //multi-frame,permessage_deflate
 	{